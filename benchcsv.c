@@ -0,0 +1,451 @@
+// *******************************************************************************************************
+// Times each stage of converting a 24-bit (or with -p, 8-bit or 32-bit) BMP file (header parse, downscale,
+// fused gather, filtered downscale with each smoothing kernel, LED aggregation and csv output) on synthetic
+// images from 43x42 px up to 16K wide, with and without row padding, and prints one line of JSON per image
+// size and stage so results can be compared from one build to the next.
+// *******************************************************************************************************
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "convert.h"
+
+// synthetic image sizes, an odd width means every scanline is padded
+typedef struct
+{
+    long width;
+    long height;
+}
+IMAGESIZE;
+
+static const IMAGESIZE sizes[] =
+{
+    {43, 42},
+    {86, 84},
+    {100, 90},
+    {640, 480},
+    {1920, 1080},
+    {1921, 1081},
+    {3840, 2160},
+    {4001, 3001},
+    {8192, 4320},
+    {16384, 2048},
+    {16383, 2047}
+};
+
+// one image and what every stage needs to run on it
+typedef struct
+{
+    char *name;
+    long width;
+    long height;
+    int bitCount;
+    long headerSize;
+    long fileSize;
+    int threads;
+    WORKSPACE *space;
+    RGBTRIPLE scaled[SCALED_MAX_HEIGHT][SCALED_MAX_WIDTH];
+    RGBTRIPLE led[LED_MAX_COUNT];
+    char csv[CSV_FRAME_SIZE];
+}
+BENCH;
+
+// a stage is run over and over, returning 0 on success and setting how many bytes it went through
+typedef struct
+{
+    char *name;
+    int (*run) (BENCH *bench, long *bytes);
+}
+STAGE;
+
+int writeImage (char *name, long width, long height, int bitCount);
+void timeStage (BENCH *bench, const STAGE *stage, double minimum);
+int runHeader (BENCH *bench, long *bytes);
+int runDownscale (BENCH *bench, long *bytes);
+int runGather (BENCH *bench, long *bytes);
+int runBilinear (BENCH *bench, long *bytes);
+int runLanczos (BENCH *bench, long *bytes);
+int runGaussian (BENCH *bench, long *bytes);
+int runAggregate (BENCH *bench, long *bytes);
+int runCSV (BENCH *bench, long *bytes);
+int readImage (BENCH *bench, bool fused, int kernel);
+
+static const STAGE stages[] =
+{
+    {"header", runHeader},
+    {"downscale", runDownscale},
+    {"gather", runGather},
+    {"bilinear", runBilinear},
+    {"lanczos", runLanczos},
+    {"gaussian", runGaussian},
+    {"aggregate", runAggregate},
+    {"csv", runCSV}
+};
+
+int main(int argc, char *argv[])
+{
+    char *usage = "Usage: ./benchcsv [-j threads] [-p bits] [-t seconds] [-w widest] [-d directory] [-m layout]\n";
+
+    // number of threads sharing the bands of an image, 0 means one per online CPU
+    long threads = 1;
+
+    // bits per pixel of the synthetic images, 8 (palette indices), 24 or 32
+    long bitCount = 24;
+
+    // every stage is repeated for at least this long
+    double minimum = 0.5;
+
+    // sizes wider than this are skipped
+    long widest = LONG_MAX;
+
+    // where the synthetic images are written while they are benchmarked
+    char *directory = ".";
+
+    // file describing the display's layout, the HERA display's is built in
+    char *layoutfile = NULL;
+
+    int opt;
+    char *end;
+    while ((opt = getopt(argc, argv, "d:j:m:p:t:w:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+                directory = optarg;
+                break;
+
+            case 'j':
+                threads = strtol(optarg, &end, 10);
+                if (*end != '\0' || threads < 0 || threads > INT_MAX)
+                {
+                    fprintf(stderr, "%s", usage);
+                    return 1;
+                }
+                break;
+
+            case 'm':
+                layoutfile = optarg;
+                break;
+
+            case 'p':
+                bitCount = strtol(optarg, &end, 10);
+                if (*end != '\0' || (bitCount != 8 && bitCount != 24 && bitCount != 32))
+                {
+                    fprintf(stderr, "%s", usage);
+                    return 1;
+                }
+                break;
+
+            case 't':
+                minimum = strtod(optarg, &end);
+                if (*end != '\0' || minimum < 0)
+                {
+                    fprintf(stderr, "%s", usage);
+                    return 1;
+                }
+                break;
+
+            case 'w':
+                widest = strtol(optarg, &end, 10);
+                if (*end != '\0' || widest < 1)
+                {
+                    fprintf(stderr, "%s", usage);
+                    return 1;
+                }
+                break;
+
+            default:
+                fprintf(stderr, "%s", usage);
+                return 1;
+        }
+    }
+    if (optind != argc)
+    {
+        fprintf(stderr, "%s", usage);
+        return 1;
+    }
+
+    if (threads == 0)
+    {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads < 1)
+        {
+            threads = 1;
+        }
+    }
+
+    if (loadLayout(layoutfile) != 0)
+    {
+        return 1;
+    }
+    selectKernels();
+
+    BENCH *bench = calloc(1, sizeof(BENCH));
+    WORKSPACE *space = calloc(1, sizeof(WORKSPACE));
+    char *name = malloc(strlen(directory) + 64);
+    if (bench == NULL || space == NULL || name == NULL)
+    {
+        free(bench);
+        free(space);
+        free(name);
+        fprintf(stderr, "Not enough memory.\n");
+        return 7;
+    }
+    bench->name = name;
+    bench->threads = threads;
+    bench->bitCount = bitCount;
+    bench->space = space;
+
+    int status = 0;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && status == 0; s++)
+    {
+        if (sizes[s].width > widest)
+        {
+            continue;
+        }
+
+        bench->width = sizes[s].width;
+        bench->height = sizes[s].height;
+        sprintf(name, "%s/benchcsv-%lix%li.bmp", directory, bench->width, bench->height);
+
+        if (writeImage(name, bench->width, bench->height, bench->bitCount) != 0)
+        {
+            fprintf(stderr, "Could not create %s.\n", name);
+            status = 4;
+            break;
+        }
+        // the headers run up to bfOffBits, where the pixels start, and take in the palette of 8-bit images
+        bench->headerSize = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) + (bench->bitCount == 8 ? 256 * 4 : 0);
+        bench->fileSize = bench->headerSize + (bench->width * bench->bitCount + 31) / 32 * 4 * bench->height;
+
+        // a stage that fails once would fail every time, so check each one before timing it
+        for (size_t t = 0; t < sizeof(stages) / sizeof(stages[0]); t++)
+        {
+            long bytes;
+            if (stages[t].run(bench, &bytes) != 0)
+            {
+                fprintf(stderr, "Stage %s failed on %s.\n", stages[t].name, name);
+                status = 7;
+                break;
+            }
+            timeStage(bench, &stages[t], minimum);
+        }
+
+        remove(name);
+    }
+
+    freeWorkspace(bench->space);
+    free(bench->name);
+    free(bench);
+    return status;
+}
+
+// writes a width x height BMP file of bitCount bits per pixel with a gradient that gives every LED a
+// different colour (8-bit images index a palette of the gradient), returns 1 if it can't be written
+int writeImage (char *name, long width, long height, int bitCount)
+{
+    long stride = (width * bitCount + 31) / 32 * 4;
+    int pixelSize = bitCount / 8;
+    int colours = bitCount == 8 ? 256 : 0;
+
+    BITMAPINFOHEADER bi =
+    {
+        .biSize = sizeof(BITMAPINFOHEADER),
+        .biWidth = width,
+        .biHeight = height,
+        .biPlanes = 1,
+        .biBitCount = bitCount,
+        .biCompression = 0,
+        .biSizeImage = stride * height,
+        .biXPelsPerMeter = 2835,
+        .biYPelsPerMeter = 2835,
+        .biClrUsed = colours
+    };
+
+    BITMAPFILEHEADER bf =
+    {
+        .bfType = 0x4d42,
+        .bfSize = bi.biSizeImage + colours * 4 + sizeof(BITMAPINFOHEADER) + sizeof(BITMAPFILEHEADER),
+        .bfOffBits = colours * 4 + sizeof(BITMAPINFOHEADER) + sizeof(BITMAPFILEHEADER)
+    };
+
+    FILE *outptr = fopen(name, "w");
+    if (outptr == NULL)
+    {
+        return 1;
+    }
+
+    // padding (and alpha) stays zero, every scanline goes out with one fwrite
+    BYTE *line = calloc(stride, 1);
+    if (line == NULL)
+    {
+        fclose(outptr);
+        return 1;
+    }
+
+    fwrite(&bf, sizeof(BITMAPFILEHEADER), 1, outptr);
+    fwrite(&bi, sizeof(BITMAPINFOHEADER), 1, outptr);
+    for (int k = 0; k < colours; k++)
+    {
+        BYTE entry[4] = {k, 255 - k, k * 7, 0};
+        fwrite(entry, sizeof(entry), 1, outptr);
+    }
+    for (long i = 0; i < height; i++)
+    {
+        for (long j = 0; j < width; j++)
+        {
+            if (bitCount == 8)
+            {
+                line[j] = (i * 255 / height + j * 255 / width) / 2;
+                continue;
+            }
+            line[pixelSize * j] = j * 255 / width;
+            line[pixelSize * j + 1] = i * 255 / height;
+            line[pixelSize * j + 2] = (i + j) * 7;
+        }
+        fwrite(line, stride, 1, outptr);
+    }
+
+    free(line);
+    bool failed = ferror(outptr);
+    return fclose(outptr) != 0 || failed ? 1 : 0;
+}
+
+// runs a stage until at least minimum seconds have gone by (and at least 3 times), then prints how it did
+void timeStage (BENCH *bench, const STAGE *stage, double minimum)
+{
+    long runs = 0;
+    long bytes = 0;
+    double best = 0;
+    double total = 0;
+    while (runs < 3 || total < minimum)
+    {
+        double start = now();
+        stage->run(bench, &bytes);
+        double seconds = now() - start;
+
+        if (runs == 0 || seconds < best)
+        {
+            best = seconds;
+        }
+        total += seconds;
+        runs++;
+    }
+
+    double mean = total / runs;
+    printf("{\"width\": %li, \"height\": %li, \"bits\": %i, \"padding\": %i, \"threads\": %i, \"stage\": \"%s\", "
+           "\"runs\": %li, \"bytes\": %li, \"seconds\": %.9f, \"best\": %.9f, \"mb_per_s\": %.3f, "
+           "\"frames_per_s\": %.3f}\n",
+           bench->width, bench->height, bench->bitCount,
+           (int) ((bench->width * bench->bitCount + 31) / 32 * 4 - bench->width * bench->bitCount / 8), bench->threads,
+           stage->name, runs, bytes, mean, best, bytes / mean / 1e6, 1 / mean);
+    fflush(stdout);
+}
+
+// opens the image and reads its headers, and the palette if it has one
+int runHeader (BENCH *bench, long *bytes)
+{
+    FILE *inptr = fopen(bench->name, "r");
+    if (inptr == NULL)
+    {
+        return 2;
+    }
+
+    BITMAPINFOHEADER bi;
+    PIXELFORMAT format;
+    int status = readHeaders(inptr, &bi, &format);
+    fclose(inptr);
+
+    *bytes = bench->headerSize;
+    return status;
+}
+
+// reads the whole image into the scaled image
+int runDownscale (BENCH *bench, long *bytes)
+{
+    *bytes = bench->fileSize;
+    return readImage(bench, false, KERNEL_AREA);
+}
+
+// reads the whole image straight into the LEDs
+int runGather (BENCH *bench, long *bytes)
+{
+    *bytes = bench->fileSize;
+    return readImage(bench, true, KERNEL_AREA);
+}
+
+// reads the whole image into the scaled image through each smoothing filter
+int runBilinear (BENCH *bench, long *bytes)
+{
+    *bytes = bench->fileSize;
+    return readImage(bench, false, KERNEL_BILINEAR);
+}
+
+int runLanczos (BENCH *bench, long *bytes)
+{
+    *bytes = bench->fileSize;
+    return readImage(bench, false, KERNEL_LANCZOS);
+}
+
+int runGaussian (BENCH *bench, long *bytes)
+{
+    *bytes = bench->fileSize;
+    return readImage(bench, false, KERNEL_GAUSSIAN);
+}
+
+// averages the scaled image into the LEDs
+int runAggregate (BENCH *bench, long *bytes)
+{
+    aggregateLEDs(bench->scaled, bench->led);
+    *bytes = sizeof(bench->scaled);
+    return 0;
+}
+
+// formats the LEDs as csv lines into memory
+int runCSV (BENCH *bench, long *bytes)
+{
+    FILE *outptr = fmemopen(bench->csv, sizeof(bench->csv), "w");
+    if (outptr == NULL)
+    {
+        return 4;
+    }
+
+    writeCSV(outptr, bench->led, 0);
+    *bytes = ftell(outptr);
+    fclose(outptr);
+    return 0;
+}
+
+// goes through the same steps as convertImage, either into the scaled image through kernel or (fused) into
+// the LEDs
+int readImage (BENCH *bench, bool fused, int kernel)
+{
+    FILE *inptr = fopen(bench->name, "r");
+    if (inptr == NULL)
+    {
+        return 2;
+    }
+
+    BITMAPINFOHEADER bi;
+    PIXELFORMAT format;
+    if (readHeaders(inptr, &bi, &format) != 0)
+    {
+        fclose(inptr);
+        return 5;
+    }
+
+    SCANLINES lines;
+    openScanlines(&lines, inptr, &bi, &format);
+    bi.biHeight = lines.height;
+
+    int status = fused ? gatherLEDs(&lines, &bi, bench->led, bench->threads, bench->space)
+                       : downscale(&lines, &bi, bench->scaled, kernel, bench->threads, bench->space);
+
+    closeScanlines(&lines);
+    fclose(inptr);
+    return status;
+}
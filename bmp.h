@@ -38,6 +38,16 @@ typedef struct
 } __attribute__((__packed__))
 BITMAPINFOHEADER;
 
+// values of biCompression for uncompressed pixels (as they are or under bit masks) and run-length encoded
+// palette indices
+// https://msdn.microsoft.com/en-us/library/cc250415.aspx
+#define BI_RGB 0
+#define BI_RLE8 1
+#define BI_RLE4 2
+#define BI_BITFIELDS 3
+#define BI_PNG 5
+#define BI_ALPHABITFIELDS 6
+
 // relative intensities of red, green, and blue
 // https://msdn.microsoft.com/en-us/library/dd162939(v=vs.85).aspx
 typedef struct
@@ -0,0 +1,3344 @@
+// *******************************************************************************************************
+// Reads an image (a BMP file of palette indices, run-length encoded or not, or of 24-bit or 32-bit colours, a
+// PNG, PPM, PGM or PAM file, raw RGB, or a frame of an animated GIF) a band of scanlines at a time, scales it
+// to the layout's image (43x42 px for HERA, or gathers it straight into the LEDs) on a pool of threads, and
+// writes the resulting LED values as csv lines or binary frames.
+// *******************************************************************************************************
+
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+#include "convert.h"
+#include "ledframes.h"
+
+// a resampling filter: its name for -k, how many pixels of the scaled image it reaches out on either side
+// and its weight at a distance from the centre of a pixel, the area kernel isn't a filter
+typedef struct
+{
+    char *name;
+    double radius;
+    double (*weight) (double x);
+}
+KERNEL;
+
+char *putNumber (char *p, unsigned int value);
+int readBitmap (FILE *inptr, BITMAPINFOHEADER *bi, PIXELFORMAT *format);
+int readNetpbm (FILE *inptr, BITMAPINFOHEADER *bi, PIXELFORMAT *format);
+int readPng (FILE *inptr, BITMAPINFOHEADER *bi, PIXELFORMAT *format);
+int skipBytes (FILE *inptr, size_t count);
+DWORD bigEndian (const BYTE *bytes);
+int readToken (FILE *inptr, char *token, size_t size, size_t *count);
+int readField (FILE *inptr, long *value, long maximum, size_t *count);
+void describeSamples (BITMAPINFOHEADER *bi, PIXELFORMAT *format, long width, long height, int samples, long maxval);
+int readFormat (PIXELFORMAT *format, BITMAPINFOHEADER *bi, const BYTE *headers, size_t size);
+int readPalette (PIXELFORMAT *format, BITMAPINFOHEADER *bi, const BYTE *headers, size_t size);
+void expandPalette (PIXELFORMAT *format);
+int convertScanlines (SCANLINES *lines, BITMAPINFOHEADER *bi, char *infile, RGBTRIPLE *led, OPTIONS *options,
+                      WORKSPACE *space, STATS *image, double *mark);
+int readAnimation (ANIMATION *gif, FILE *inptr);
+int findImage (ANIMATION *gif, size_t *position, int *delay, int *disposal, int *transparent);
+int skipSubBlocks (ANIMATION *gif, size_t *position);
+int decodeLZW (ANIMATION *gif, int minimumBits, long count, long *decoded);
+void disposeFrame (ANIMATION *gif);
+void fillCanvas (ANIMATION *gif, long left, long top, long width, long height);
+void sumPixelsScalar (const BYTE *pixels, long count, long *blue, long *green, long *red);
+void filterPixelsScalar (const BYTE *pixels, const float *weights, int count, float *bgr);
+void filterLinesScalar (const float *lines, long stride, const float *weights, int count, int width, float *sum);
+void packPixelsScalar (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format);
+void blendPixels (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format);
+void unmaskPixels (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format);
+void expandIndices (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format);
+void swapPixelsScalar (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format);
+void unpackSamples (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format);
+#ifdef HAVE_X86_KERNELS
+void sumPixelsSSE2 (const BYTE *pixels, long count, long *blue, long *green, long *red);
+void sumPixelsAVX2 (const BYTE *pixels, long count, long *blue, long *green, long *red);
+void filterPixelsSSE2 (const BYTE *pixels, const float *weights, int count, float *bgr);
+void filterLinesSSE2 (const float *lines, long stride, const float *weights, int count, int width, float *sum);
+void packPixelsSSSE3 (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format);
+void swapPixelsSSSE3 (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format);
+#endif
+void *downscaleBands (void *arg);
+void *resampleBands (void *arg);
+void sumColumns (const BYTE *scanline, const COVERAGE *columns, COLUMNSUMS *sums);
+void weighColumns (const COLUMNSUMS *sums, const COVERAGE *columns, long rowWeight, long total[][SCALED_MAX_WIDTH]);
+const RESAMPLE *prepareResample (WORKSPACE *space, BITMAPINFOHEADER *bi);
+void measureCoverage (COVERAGE *coverage, int scaledSize, long size);
+int downscaleFiltered (SCANLINES *lines, BITMAPINFOHEADER *bi, RGBTRIPLE scaled[][SCALED_MAX_WIDTH], int kernel,
+                       int threads, WORKSPACE *space);
+void *filterBands (void *arg);
+void filterColumns (const FILTERS *filters, const float *filtered, RGBTRIPLE scaled[][SCALED_MAX_WIDTH]);
+BYTE toByte (float value);
+const FILTERS *prepareFilters (WORKSPACE *space, BITMAPINFOHEADER *bi, int kernel);
+int measureBank (FILTERBANK *bank, const KERNEL *kernel, int scaledSize, long size);
+double triangleWeight (double x);
+double lanczosWeight (double x);
+double gaussianWeight (double x);
+void measureFootprint (FOOTPRINT *footprint, long pxColumns, long pxRows);
+void *gatherBands (void *arg);
+int runBands (BANDS *bands, int threads, void *(*worker) (void *), BUFFER *buffer);
+int allocateBand (WORKER *worker, BYTE **buffer);
+int growBuffer (BUFFER *buffer, size_t size);
+const BYTE *nextDecodedLines (SCANLINES *lines, long first, long count, BYTE *buffer);
+int readRuns (SCANLINES *lines);
+int decodeRunLine (SCANLINES *lines, BYTE *pixels);
+void fillPixels (BYTE *pixels, const BYTE *colour, long count);
+int startPng (SCANLINES *lines);
+bool fillPng (void *source, const BYTE **next, size_t *available);
+int readStored (SCANLINES *lines, BYTE *bytes, size_t count);
+int nextChunk (SCANLINES *lines);
+int decodePngLine (SCANLINES *lines, BYTE *pixels);
+int unfilterScanline (BYTE *row, const BYTE *prior, long size, int pixelBytes, int filter);
+void finishPng (SCANLINES *lines);
+const BYTE *claimBand (BANDS *bands, BYTE *buffer, int *band);
+
+// sums the blue, green and red bytes of count packed BGR pixels onto *blue, *green and *red,
+// picked by selectKernels for the CPU we are running on
+void (*sumPixels) (const BYTE *pixels, long count, long *blue, long *green, long *red) = sumPixelsScalar;
+
+// adds count packed BGR pixels weighted by weights onto bgr (blue, green, red and a spare fourth lane),
+// picked by selectKernels for the CPU we are running on
+void (*filterPixels) (const BYTE *pixels, const float *weights, int count, float *bgr) = filterPixelsScalar;
+
+// sets sum to count horizontally filtered scanlines of width pixels (four floats each), stride floats apart,
+// weighted by weights, picked by selectKernels for the CPU we are running on
+void (*filterLines) (const float *lines, long stride, const float *weights, int count, int width, float *sum) =
+    filterLinesScalar;
+
+// drops the fourth byte of 32-bit BGRX pixels, picked by selectKernels for the CPU we are running on
+void (*packPixels) (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format) = packPixelsScalar;
+
+// turns RGB pixels into BGR ones, picked by selectKernels for the CPU we are running on
+void (*swapPixels) (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format) = swapPixelsScalar;
+
+// every kernel, in the order of their KERNEL_ numbers
+static const KERNEL kernels[] =
+{
+    {"area", 0, NULL},
+    {"bilinear", 1, triangleWeight},
+    {"lanczos", 3, lanczosWeight},
+    {"gaussian", 2, gaussianWeight}
+};
+
+// writes the binary header that comes before the first frame, frameCount can be 0 if it isn't known yet,
+// csv has no header, returns the bytes written
+size_t startOutput (FILE *outptr, int frameCount, OPTIONS *options)
+{
+    if (!options->binary)
+    {
+        return 0;
+    }
+
+    LEDFRAMESHEADER header =
+    {
+        .version = LEDFRAMES_VERSION,
+        .ledCount = layout.ledCount,
+        .frameCount = frameCount,
+        .fps = options->fps
+    };
+    memcpy(header.magic, LEDFRAMES_MAGIC, sizeof(header.magic));
+    fwrite(&header, sizeof(LEDFRAMESHEADER), 1, outptr);
+    return sizeof(LEDFRAMESHEADER);
+}
+
+// fills in the real frame count of a binary file once all frames are written, if outptr can seek back to
+// the header, a stream that can't keeps 0 which players read as "until the end of the stream"
+void finishOutput (FILE *outptr, int frameCount, OPTIONS *options)
+{
+    if (!options->binary)
+    {
+        return;
+    }
+
+    uint32_t count = frameCount;
+    if (fseek(outptr, offsetof(LEDFRAMESHEADER, frameCount), SEEK_SET) == 0)
+    {
+        fwrite(&count, sizeof(uint32_t), 1, outptr);
+    }
+}
+
+// writes one frame of LED values in the chosen output format, returns the bytes written
+size_t writeFrame (FILE *outptr, RGBTRIPLE *led, int frame, OPTIONS *options)
+{
+    if (options->binary)
+    {
+        return writeBinary(outptr, led);
+    }
+    else
+    {
+        return writeCSV(outptr, led, frame);
+    }
+}
+
+// writes one frame of LED values as packed red, green, blue bytes with a single fwrite
+size_t writeBinary (FILE *outptr, RGBTRIPLE *led)
+{
+    BYTE buffer[LED_MAX_COUNT * 3];
+    size_t size = layout.ledCount * 3;
+    for (int n = 0; n < layout.ledCount; n++)
+    {
+        buffer[3 * n] = led[n].rgbtRed;
+        buffer[3 * n + 1] = led[n].rgbtGreen;
+        buffer[3 * n + 2] = led[n].rgbtBlue;
+    }
+    fwrite(buffer, size, 1, outptr);
+    return size;
+}
+
+// writes one frame of LED values as csv lines, frames after the first start on a new line, the whole frame is
+// formatted into one buffer and handed to stdio with a single fwrite
+size_t writeCSV (FILE *outptr, RGBTRIPLE *led, int frame)
+{
+    char buffer[CSV_FRAME_SIZE];
+    char *end = buffer;
+
+    if (frame > 0)
+    {
+        *end++ = '\n';
+    }
+
+    for (int n = 0; n < layout.ledCount; n++)
+    {
+        end = putNumber(end, n);
+        *end++ = ',';
+        *end++ = ' ';
+        end = putNumber(end, led[n].rgbtRed);
+        *end++ = ',';
+        *end++ = ' ';
+        end = putNumber(end, led[n].rgbtGreen);
+        *end++ = ',';
+        *end++ = ' ';
+        end = putNumber(end, led[n].rgbtBlue);
+        if (n < layout.ledCount - 1)
+        {
+            *end++ = '\n';
+        }
+    }
+
+    fwrite(buffer, 1, end - buffer, outptr);
+    return end - buffer;
+}
+
+// writes value in decimal at p, two digits at a time from a lookup table, and returns the end of it
+char *putNumber (char *p, unsigned int value)
+{
+    static const char digitPairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    // fill in from the right of a scratch buffer, then copy the digits over
+    char digits[10];
+    char *d = digits + sizeof(digits);
+    while (value >= 100)
+    {
+        d -= 2;
+        memcpy(d, digitPairs + 2 * (value % 100), 2);
+        value /= 100;
+    }
+    if (value >= 10)
+    {
+        d -= 2;
+        memcpy(d, digitPairs + 2 * value, 2);
+    }
+    else
+    {
+        *--d = '0' + value;
+    }
+
+    size_t length = digits + sizeof(digits) - d;
+    memcpy(p, d, length);
+    return p + length;
+}
+
+// reads infile's headers (leaving it at its first scanline) and works out how its pixels are stored, as a
+// BITMAPINFOHEADER whatever kind of file it is, making sure it's an image we can convert, returning 5 (the
+// exit status) if not
+int readHeaders (FILE *inptr, BITMAPINFOHEADER *bi, PIXELFORMAT *format)
+{
+    // netpbm files start with a P, PNG files with 0x89 and BMP files with BM (GIF files, starting with a G, are
+    // picked out by isAnimation before this)
+    int c = getc(inptr);
+    ungetc(c, inptr);
+    int status = c == 'P' ? readNetpbm(inptr, bi, format) : c == 0x89 ? readPng(inptr, bi, format)
+                                                                     : readBitmap(inptr, bi, format);
+    if (status != 0)
+    {
+        fprintf(stderr, "Unsupported input file format.  Needs to be 1, 4, 8, 24 or 32-bit Bitmap file "
+                "(.bmp, use Paint to convert) or PNG, PPM, PGM or PAM file\n");
+        return 5;
+    }
+
+    return 0;
+}
+
+// reads the headers of a BMP file, returns 1 if it isn't one we can read
+int readBitmap (FILE *inptr, BITMAPINFOHEADER *bi, PIXELFORMAT *format)
+{
+    // read infile's BITMAPFILEHEADER, then everything up to its pixels in one go
+    BITMAPFILEHEADER bf;
+    BYTE headers[HEADERS_MAX];
+    bool complete = fread(&bf, sizeof(BITMAPFILEHEADER), 1, inptr) == 1 && bf.bfType == 0x4d42 &&
+                    bf.bfOffBits >= sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) &&
+                    bf.bfOffBits - sizeof(BITMAPFILEHEADER) <= HEADERS_MAX &&
+                    fread(headers, bf.bfOffBits - sizeof(BITMAPFILEHEADER), 1, inptr) == 1;
+    size_t size = complete ? bf.bfOffBits - sizeof(BITMAPFILEHEADER) : 0;
+    if (complete)
+    {
+        memcpy(bi, headers, sizeof(BITMAPINFOHEADER));
+    }
+
+    // ensure infile is (likely) a BMP we can read with a BITMAPINFOHEADER or one of the later versions that
+    // only add fields after it (V2 to V5), a negative height means its rows are stored top-down
+    if (!complete || (bi->biSize != 40 && bi->biSize != 52 && bi->biSize != 56 && bi->biSize != 108 &&
+        bi->biSize != 124) || bi->biSize > size || bi->biWidth < 1 || bi->biHeight == 0 ||
+        bi->biHeight < -INT32_MAX || readFormat(format, bi, headers, size) != 0)
+    {
+        return 1;
+    }
+
+    format->headerSize = bf.bfOffBits;
+    return 0;
+}
+
+// reads the headers of a PPM (P6), PGM (P5) or PAM (P7) file, returns 1 if it isn't one we can read
+int readNetpbm (FILE *inptr, BITMAPINFOHEADER *bi, PIXELFORMAT *format)
+{
+    char token[16];
+    size_t count = 0;
+    if (readToken(inptr, token, sizeof(token), &count) != 0)
+    {
+        return 1;
+    }
+
+    long width = 0;
+    long height = 0;
+    long depth = 0;
+    long maxval = 0;
+    if (strcmp(token, "P5") == 0 || strcmp(token, "P6") == 0)
+    {
+        // width, height and maxval, then a single whitespace character before the pixels
+        depth = token[1] == '5' ? 1 : 3;
+        if (readField(inptr, &width, INT32_MAX, &count) != 0 || readField(inptr, &height, INT32_MAX, &count) != 0 ||
+            readField(inptr, &maxval, 65535, &count) != 0)
+        {
+            return 1;
+        }
+    }
+    else if (strcmp(token, "P7") == 0)
+    {
+        // a line per field up to ENDHDR, the tuple type follows from the depth
+        while (true)
+        {
+            if (readToken(inptr, token, sizeof(token), &count) != 0)
+            {
+                return 1;
+            }
+
+            int status = 0;
+            if (strcmp(token, "ENDHDR") == 0)
+            {
+                break;
+            }
+            else if (strcmp(token, "WIDTH") == 0)
+            {
+                status = readField(inptr, &width, INT32_MAX, &count);
+            }
+            else if (strcmp(token, "HEIGHT") == 0)
+            {
+                status = readField(inptr, &height, INT32_MAX, &count);
+            }
+            else if (strcmp(token, "DEPTH") == 0)
+            {
+                status = readField(inptr, &depth, 4, &count);
+            }
+            else if (strcmp(token, "MAXVAL") == 0)
+            {
+                status = readField(inptr, &maxval, 65535, &count);
+            }
+            else if (strcmp(token, "TUPLTYPE") == 0)
+            {
+                status = readToken(inptr, token, sizeof(token), &count);
+            }
+            else
+            {
+                status = 1;
+            }
+            if (status != 0)
+            {
+                return 1;
+            }
+        }
+    }
+    else
+    {
+        return 1;
+    }
+
+    if (width < 1 || height < 1 || depth < 1 || maxval < 1)
+    {
+        return 1;
+    }
+    describeSamples(bi, format, width, height, depth, maxval);
+    format->headerSize = count;
+    return 0;
+}
+
+// reads the chunks of a PNG file up to its first IDAT chunk, leaving infile at the compressed pixels in it,
+// returns 1 if it isn't one we can read: interlaced PNGs can't be read a scanline at a time and aren't, and
+// transparency (tRNS) and every other ancillary chunk is skipped, as are chunk CRCs
+int readPng (FILE *inptr, BITMAPINFOHEADER *bi, PIXELFORMAT *format)
+{
+    BYTE signature[8];
+    if (fread(signature, sizeof(signature), 1, inptr) != 1 || memcmp(signature, "\x89PNG\r\n\x1a\n", 8) != 0)
+    {
+        return 1;
+    }
+    size_t count = sizeof(signature);
+
+    // IHDR comes first, PLTE (if there is one) before the pixels
+    BYTE header[13];
+    bool headerRead = false;
+    BYTE palette[256 * 3];
+    long colours = -1;
+    BYTE chunk[8];
+    while (true)
+    {
+        if (fread(chunk, sizeof(chunk), 1, inptr) != 1)
+        {
+            return 1;
+        }
+        count += sizeof(chunk);
+        DWORD length = bigEndian(chunk);
+        if (length > INT32_MAX || (!headerRead && memcmp(chunk + 4, "IHDR", 4) != 0))
+        {
+            return 1;
+        }
+        if (memcmp(chunk + 4, "IDAT", 4) == 0)
+        {
+            format->chunkLength = length;
+            break;
+        }
+
+        int status = 0;
+        if (memcmp(chunk + 4, "IHDR", 4) == 0)
+        {
+            status = headerRead || length != sizeof(header) || fread(header, sizeof(header), 1, inptr) != 1;
+            headerRead = true;
+        }
+        else if (memcmp(chunk + 4, "PLTE", 4) == 0)
+        {
+            colours = length / 3;
+            status = length % 3 != 0 || length > sizeof(palette) || fread(palette, length, 1, inptr) != 1;
+        }
+        else
+        {
+            status = memcmp(chunk + 4, "IEND", 4) == 0 || skipBytes(inptr, length) != 0;
+        }
+
+        // every chunk ends with its CRC
+        if (status != 0 || skipBytes(inptr, 4) != 0)
+        {
+            return 1;
+        }
+        count += length + 4;
+    }
+
+    // greys and colours of 8 or 16 bits a sample, or palette indices (or greys) of up to 8 bits a pixel
+    long width = bigEndian(header);
+    long height = bigEndian(header + 4);
+    int depth = header[8];
+    int colourType = header[9];
+    bool indexed = colourType == 3 || (colourType == 0 && depth < 8);
+    bool depthOk = colourType == 0 ? depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16
+                 : colourType == 3 ? depth == 1 || depth == 2 || depth == 4 || depth == 8
+                 : colourType == 2 || colourType == 4 || colourType == 6 ? depth == 8 || depth == 16 : false;
+    if (width < 1 || width > INT32_MAX || height < 1 || height > INT32_MAX || !depthOk || header[10] != 0 ||
+        header[11] != 0 || header[12] != 0 || (colourType == 3 && colours < 1))
+    {
+        return 1;
+    }
+
+    int samples = colourType == 2 ? 3 : colourType == 4 ? 2 : colourType == 6 ? 4 : 1;
+    describeSamples(bi, format, width, height, samples, depth == 16 ? 65535 : 255);
+    format->compression = BI_PNG;
+    bi->biCompression = BI_PNG;
+    if (indexed)
+    {
+        // greys of fewer than 8 bits are looked up in a palette of them, indices past the end of a palette
+        // are black
+        format->samples = 0;
+        format->bitCount = depth;
+        bi->biBitCount = depth;
+        memset(format->palette, 0, sizeof(format->palette));
+        long levels = 1L << depth;
+        for (long i = 0; i < levels; i++)
+        {
+            if (colourType == 0)
+            {
+                memset(format->palette[i], i * 255 / (levels - 1), 3);
+            }
+            else if (i < colours)
+            {
+                format->palette[i][0] = palette[3 * i + 2];
+                format->palette[i][1] = palette[3 * i + 1];
+                format->palette[i][2] = palette[3 * i];
+            }
+        }
+        expandPalette(format);
+    }
+
+    format->headerSize = count;
+    return 0;
+}
+
+// reads past count bytes of infile, which may not be able to seek, returns 1 if it ends first
+int skipBytes (FILE *inptr, size_t count)
+{
+    BYTE scratch[4096];
+    while (count > 0)
+    {
+        size_t size = count < sizeof(scratch) ? count : sizeof(scratch);
+        if (fread(scratch, size, 1, inptr) != 1)
+        {
+            return 1;
+        }
+        count -= size;
+    }
+    return 0;
+}
+
+// the big-endian 32-bit number at bytes, as PNG stores them
+DWORD bigEndian (const BYTE *bytes)
+{
+    return (DWORD) bytes[0] << 24 | (DWORD) bytes[1] << 16 | (DWORD) bytes[2] << 8 | bytes[3];
+}
+
+// reads the next token of a netpbm header into token (which holds size bytes), skipping whitespace and
+// comments before it and the one whitespace character after it, adds the bytes read to count, returns 1 if
+// there's no token or it doesn't fit
+int readToken (FILE *inptr, char *token, size_t size, size_t *count)
+{
+    int c = getc(inptr);
+    while (c == '#' || c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f')
+    {
+        // a comment runs to the end of its line
+        while (c == '#' && c != '\n' && c != EOF)
+        {
+            (*count)++;
+            c = getc(inptr);
+            while (c != '\n' && c != EOF)
+            {
+                (*count)++;
+                c = getc(inptr);
+            }
+        }
+        if (c != EOF)
+        {
+            (*count)++;
+            c = getc(inptr);
+        }
+    }
+
+    size_t length = 0;
+    while (c != EOF && c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != '\v' && c != '\f')
+    {
+        if (length + 1 == size)
+        {
+            return 1;
+        }
+        token[length++] = c;
+        (*count)++;
+        c = getc(inptr);
+    }
+    token[length] = '\0';
+    if (c != EOF)
+    {
+        (*count)++;
+    }
+
+    return length == 0 ? 1 : 0;
+}
+
+// reads a number from 1 to maximum as the next token of a netpbm header, returns 1 if it isn't one
+int readField (FILE *inptr, long *value, long maximum, size_t *count)
+{
+    char token[16];
+    if (readToken(inptr, token, sizeof(token), count) != 0 || strspn(token, "0123456789") != strlen(token))
+    {
+        return 1;
+    }
+    *value = strtol(token, NULL, 10);
+    return *value < 1 || *value > maximum ? 1 : 0;
+}
+
+// describes a width x height image of raw 8-bit RGB pixels, stored top-down with no headers
+void rawHeaders (BITMAPINFOHEADER *bi, PIXELFORMAT *format, long width, long height)
+{
+    describeSamples(bi, format, width, height, 3, 255);
+    format->headerSize = 0;
+}
+
+// sets up the headers of a top-down width x height image of pixels made of samples up to maxval each
+void describeSamples (BITMAPINFOHEADER *bi, PIXELFORMAT *format, long width, long height, int samples, long maxval)
+{
+    format->samples = samples;
+    format->sampleBytes = maxval > 255 ? 2 : 1;
+    format->maxval = maxval;
+    format->bitCount = samples * format->sampleBytes * 8;
+    format->compression = BI_RGB;
+    format->blend = false;
+
+    memset(bi, 0, sizeof(BITMAPINFOHEADER));
+    bi->biSize = sizeof(BITMAPINFOHEADER);
+    bi->biWidth = width;
+    bi->biHeight = -height;
+    bi->biPlanes = 1;
+    bi->biBitCount = format->bitCount;
+    bi->biCompression = BI_RGB;
+    bi->biXPelsPerMeter = 2835;
+    bi->biYPelsPerMeter = 2835;
+}
+
+// works out how the pixels of a bi shaped image are stored from the size bytes of headers that follow its
+// BITMAPFILEHEADER, returns 1 if they aren't stored in a way we can read
+int readFormat (PIXELFORMAT *format, BITMAPINFOHEADER *bi, const BYTE *headers, size_t size)
+{
+    format->bitCount = bi->biBitCount;
+    format->compression = bi->biCompression;
+    format->samples = 0;
+    format->blend = false;
+    if (bi->biBitCount == 24 && bi->biCompression == BI_RGB)
+    {
+        return 0;
+    }
+    if (bi->biBitCount == 1 || bi->biBitCount == 4 || bi->biBitCount == 8)
+    {
+        return readPalette(format, bi, headers, size);
+    }
+    if (bi->biBitCount != 32)
+    {
+        return 1;
+    }
+
+    // without bit masks 32-bit pixels are BGR with the top byte unused, unless a V3 or later header
+    // gives it an alpha mask
+    DWORD masks[4] = {0x000000ff, 0x0000ff00, 0x00ff0000, 0};
+    if (bi->biCompression == BI_BITFIELDS || bi->biCompression == BI_ALPHABITFIELDS)
+    {
+        // red, green, blue and (maybe) alpha masks come right after the BITMAPINFOHEADER fields, as part
+        // of the later headers or on their own
+        int count = bi->biCompression == BI_ALPHABITFIELDS || bi->biSize >= 56 ? 4 : 3;
+        if (size < sizeof(BITMAPINFOHEADER) + count * sizeof(DWORD))
+        {
+            return 1;
+        }
+        DWORD stored[4] = {0};
+        memcpy(stored, headers + sizeof(BITMAPINFOHEADER), count * sizeof(DWORD));
+        masks[0] = stored[2];
+        masks[1] = stored[1];
+        masks[2] = stored[0];
+        masks[3] = stored[3];
+    }
+    else if (bi->biCompression == BI_RGB)
+    {
+        if (bi->biSize >= 56)
+        {
+            memcpy(&masks[3], headers + sizeof(BITMAPINFOHEADER) + 3 * sizeof(DWORD), sizeof(DWORD));
+        }
+    }
+    else
+    {
+        return 1;
+    }
+
+    // every mask has to be one run of bits, only alpha can be missing
+    for (int c = 0; c < 4; c++)
+    {
+        format->masks[c] = masks[c];
+        format->shifts[c] = 0;
+        format->bits[c] = 0;
+        if (masks[c] == 0)
+        {
+            if (c < 3)
+            {
+                return 1;
+            }
+            continue;
+        }
+
+        DWORD run = masks[c];
+        while ((run & 1) == 0)
+        {
+            run >>= 1;
+            format->shifts[c]++;
+        }
+        if ((run & (run + 1)) != 0)
+        {
+            return 1;
+        }
+        while (run != 0)
+        {
+            run >>= 1;
+            format->bits[c]++;
+        }
+    }
+
+    return 0;
+}
+
+// reads the palette of a bi shaped image of palette indices from the size bytes of headers that follow its
+// BITMAPFILEHEADER and builds the table that expands bytes of indices, returns 1 if the palette is missing
+// or the indices are stored in a way we can't read
+int readPalette (PIXELFORMAT *format, BITMAPINFOHEADER *bi, const BYTE *headers, size_t size)
+{
+    // only 8-bit and 4-bit indices can be run-length encoded, and only bottom-up
+    bool runs = (bi->biCompression == BI_RLE8 && bi->biBitCount == 8) ||
+                (bi->biCompression == BI_RLE4 && bi->biBitCount == 4);
+    if ((bi->biCompression != BI_RGB && !runs) || (runs && bi->biHeight < 0))
+    {
+        return 1;
+    }
+
+    // the palette follows the info header with biClrUsed BGRX entries (or every one there can be when 0),
+    // indices past its end are black
+    long colours = 1L << bi->biBitCount;
+    if (bi->biClrUsed != 0 && bi->biClrUsed < colours)
+    {
+        colours = bi->biClrUsed;
+    }
+    if (size < bi->biSize + (size_t) colours * 4)
+    {
+        return 1;
+    }
+    memset(format->palette, 0, sizeof(format->palette));
+    for (long i = 0; i < colours; i++)
+    {
+        const BYTE *entry = headers + bi->biSize + 4 * i;
+        format->palette[i][0] = entry[0];
+        format->palette[i][1] = entry[1];
+        format->palette[i][2] = entry[2];
+    }
+    expandPalette(format);
+
+    return 0;
+}
+
+// builds the table that expands every byte of indices into the colours of the pixels it holds
+void expandPalette (PIXELFORMAT *format)
+{
+    int bits = format->bitCount;
+    for (int byte = 0; byte < 256; byte++)
+    {
+        for (int k = 0; k < 8 / bits; k++)
+        {
+            int index = byte >> (8 - bits * (k + 1)) & ((1 << bits) - 1);
+            memcpy(&format->expand[byte][3 * k], format->palette[index], 3);
+        }
+    }
+}
+
+// reads one image and works out the colour of every LED from it, returning the exit status for it
+int convertImage (char *infile, RGBTRIPLE *led, OPTIONS *options, WORKSPACE *space)
+{
+    double mark = now();
+
+    // open input file, - reads the next image from stdin
+    bool piped = strcmp(infile, "-") == 0;
+    FILE *inptr = piped ? stdin : fopen(infile, "r");
+    if (inptr == NULL)
+    {
+        fprintf(stderr, "Could not open %s.\n", infile);
+        return 2;
+    }
+
+    int status = convertInput(inptr, infile, led, options, space, lap(&mark));
+
+    // close infile, stdin stays open for any images after this one
+    if (!piped)
+    {
+        fclose(inptr);
+    }
+    return status;
+}
+
+// reads one image from inptr, already opened (which took opening seconds) and left open, and works out the
+// colour of every LED from it, returning the exit status for it
+int convertInput (FILE *inptr, char *infile, RGBTRIPLE *led, OPTIONS *options, WORKSPACE *space, double opening)
+{
+    // every stage is timed from the end of the one before
+    STATS image = {.images = 1, .open = opening};
+    double mark = now();
+
+    // read and check infile's headers, raw pixels have none
+    BITMAPINFOHEADER bi;
+    PIXELFORMAT format;
+    if (options->rawWidth > 0)
+    {
+        rawHeaders(&bi, &format, options->rawWidth, options->rawHeight);
+    }
+    else if (readHeaders(inptr, &bi, &format) != 0)
+    {
+        return 5;
+    }
+    format.blend = options->blend;
+    format.background = options->background;
+    image.header = lap(&mark);
+    image.bytesRead = format.headerSize;
+    image.readCalls = 2;
+
+    // pull whole bands of scanlines (pixels and padding) from infile with one read each, in bottom-up order
+    // whichever way infile stores them, so from here on infile is as tall as the absolute height
+    SCANLINES lines;
+    openScanlines(&lines, inptr, &bi, &format);
+    bi.biHeight = lines.height;
+
+    return convertScanlines(&lines, &bi, infile, led, options, space, &image, &mark);
+}
+
+// scales the scanlines of an image bi shaped (as tall as its absolute height) and works out the colour of
+// every LED from them, adding the time it took since mark to image, which then goes into the totals,
+// returning the exit status for it
+int convertScanlines (SCANLINES *lines, BITMAPINFOHEADER *bi, char *infile, RGBTRIPLE *led, OPTIONS *options,
+                      WORKSPACE *space, STATS *image, double *mark)
+{
+    char *tempfile = "temp.bmp";
+
+    // scaled image is always a plain 24-bit BMP, whatever infile was
+    BITMAPFILEHEADER obf =
+    {
+        .bfType = 0x4d42,
+        .bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER)
+    };
+    BITMAPINFOHEADER obi =
+    {
+        .biSize = sizeof(BITMAPINFOHEADER),
+        .biPlanes = 1,
+        .biBitCount = 24,
+        .biCompression = BI_RGB,
+        .biXPelsPerMeter = bi->biXPelsPerMeter,
+        .biYPelsPerMeter = bi->biYPelsPerMeter
+    };
+
+    // dimensions of scaled image are set by the layout
+    obi.biWidth = layout.width;
+    obi.biHeight = layout.height;
+
+    // determine padding for scanlines
+    int oPadding = (4 - (obi.biWidth * sizeof(RGBTRIPLE)) % 4) % 4;
+
+    obi.biSizeImage = ((sizeof(RGBTRIPLE) * obi.biWidth) + oPadding) * abs(obi.biHeight);
+    obf.bfSize = obi.biSizeImage + sizeof(BITMAPINFOHEADER) + sizeof(BITMAPFILEHEADER);
+
+    // scaled image is kept in memory with its rows in the same bottom-up order as a BMP file
+    RGBTRIPLE scaled[SCALED_MAX_HEIGHT][SCALED_MAX_WIDTH];
+
+    // either go through the scaled image or accumulate infile straight into the LEDs
+    int status = options->fused ? gatherLEDs(lines, bi, led, options->threads, space)
+                                : downscale(lines, bi, scaled, options->kernel, options->threads, space);
+
+    closeScanlines(lines);
+
+    image->downscale = lap(mark);
+    image->bytesRead += lines->bytes;
+    image->readCalls += lines->reads;
+
+    if (status != 0)
+    {
+        fprintf(stderr, status == 2 ? "Not enough memory to read %s.\n" : "Could not read %s.\n", infile);
+        return 7;
+    }
+
+    if (!options->fused)
+    {
+        // write scaled image out for debugging
+        if (options->writeTemp && writeScaled(tempfile, &obf, &obi, scaled) != 0)
+        {
+            fprintf(stderr, "Could not create %s.\n", tempfile);
+            return 3;
+        }
+        if (options->writeTemp)
+        {
+            image->temp = lap(mark);
+            image->bytesWritten = obf.bfSize;
+        }
+
+        aggregateLEDs(scaled, led);
+        image->aggregate = lap(mark);
+    }
+
+    addStats(options->stats, image);
+    return 0;
+}
+
+// tells whether the image coming next on inptr is a GIF, which starts with a G, peeking at it the same way
+// readHeaders does so a pipe loses nothing (raw pixels are never taken for one)
+bool isAnimation (FILE *inptr, OPTIONS *options)
+{
+    if (options->rawWidth > 0)
+    {
+        return false;
+    }
+    int c = getc(inptr);
+    ungetc(c, inptr);
+    return c == 'G';
+}
+
+// reads the whole of the GIF infile from inptr (which is left open), finds the delays of its frames and sets
+// up its canvas, filled with the background (black unless alpha is being blended), returning the exit status
+// for it
+int openAnimation (ANIMATION *gif, FILE *inptr, char *infile, OPTIONS *options)
+{
+    memset(gif, 0, sizeof(ANIMATION));
+    gif->background = options->blend ? options->background : (RGBTRIPLE) {0, 0, 0};
+
+    if (readAnimation(gif, inptr) != 0)
+    {
+        fprintf(stderr, "Could not read %s.\n", infile);
+        closeAnimation(gif);
+        return 7;
+    }
+
+    // the logical screen and the global palette (if there is one) come first
+    const BYTE *data = gif->data;
+    if (gif->size < 13 || (memcmp(data, "GIF87a", 6) != 0 && memcmp(data, "GIF89a", 6) != 0))
+    {
+        fprintf(stderr, "Unsupported input file format.  %s isn't a GIF file\n", infile);
+        closeAnimation(gif);
+        return 5;
+    }
+    gif->width = data[6] | data[7] << 8;
+    gif->height = data[8] | data[9] << 8;
+    gif->position = 13;
+    if ((data[10] & 0x80) != 0)
+    {
+        gif->colours = 2 << (data[10] & 7);
+        if (gif->size < 13 + 3 * (size_t) gif->colours)
+        {
+            fprintf(stderr, "Could not read %s.\n", infile);
+            closeAnimation(gif);
+            return 7;
+        }
+        for (int i = 0; i < gif->colours; i++)
+        {
+            gif->palette[i][0] = data[13 + 3 * i + 2];
+            gif->palette[i][1] = data[13 + 3 * i + 1];
+            gif->palette[i][2] = data[13 + 3 * i];
+        }
+        gif->position += 3 * gif->colours;
+    }
+
+    // every frame's delay, found by skipping over the frames, so the frame rate can be worked out before
+    // any are decoded, a frame with a delay of 0 or 1 is shown for 1/10 s the same as browsers do, and a file
+    // cut short ends with the last whole frame
+    size_t position = gif->position;
+    int delay;
+    while (findImage(gif, &position, &delay, NULL, NULL) == 0 && gif->size - position >= 11)
+    {
+        // the image descriptor, then its own palette, the size of its first codes and its indices
+        BYTE packed = data[position + 9];
+        position += 10 + ((packed & 0x80) != 0 ? 3 * (2 << (packed & 7)) : 0) + 1;
+        if (position > gif->size || skipSubBlocks(gif, &position) != 0)
+        {
+            break;
+        }
+
+        int *delays = realloc(gif->delays, (gif->frameCount + 1) * sizeof(int));
+        if (delays == NULL)
+        {
+            fprintf(stderr, "Not enough memory to read %s.\n", infile);
+            closeAnimation(gif);
+            return 7;
+        }
+        gif->delays = delays;
+        gif->delays[gif->frameCount++] = delay < 2 ? 10 : delay;
+    }
+    if (gif->frameCount == 0 || gif->width == 0 || gif->height == 0)
+    {
+        fprintf(stderr, "Could not read %s.\n", infile);
+        closeAnimation(gif);
+        return 7;
+    }
+
+    gif->stride = (gif->width * 3 + 3) / 4 * 4;
+    gif->canvas = malloc(gif->stride * gif->height);
+    if (gif->canvas == NULL)
+    {
+        fprintf(stderr, "Not enough memory to read %s.\n", infile);
+        closeAnimation(gif);
+        return 7;
+    }
+    fillCanvas(gif, 0, 0, gif->width, gif->height);
+    return 0;
+}
+
+// reads the whole of a GIF into memory, mapping it if it's a regular file, returns 1 if it can't
+int readAnimation (ANIMATION *gif, FILE *inptr)
+{
+    struct stat st;
+    if (fstat(fileno(inptr), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && ftello(inptr) == 0)
+    {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(inptr), 0);
+        if (map != MAP_FAILED)
+        {
+            gif->data = map;
+            gif->size = st.st_size;
+            gif->mapped = true;
+            return 0;
+        }
+    }
+
+    size_t capacity = 0;
+    size_t got;
+    do
+    {
+        if (gif->size == capacity)
+        {
+            capacity = capacity == 0 ? 65536 : 2 * capacity;
+            BYTE *grown = realloc(gif->data, capacity);
+            if (grown == NULL)
+            {
+                return 1;
+            }
+            gif->data = grown;
+        }
+        got = fread(gif->data + gif->size, 1, capacity - gif->size, inptr);
+        gif->size += got;
+    }
+    while (got > 0);
+    return 0;
+}
+
+// walks the extension blocks from position up to the next image descriptor, leaving position at it and
+// taking the delay, disposal method and transparent index (-1 for none) of the image from the graphic
+// control extension before it (any of them can be NULL), returns -1 at the trailer (or the end of the file)
+// and 1 if a block runs past the end
+int findImage (ANIMATION *gif, size_t *position, int *delay, int *disposal, int *transparent)
+{
+    const BYTE *data = gif->data;
+    if (delay != NULL)
+    {
+        *delay = 0;
+    }
+    if (disposal != NULL)
+    {
+        *disposal = 0;
+    }
+    if (transparent != NULL)
+    {
+        *transparent = -1;
+    }
+
+    while (*position < gif->size && data[*position] != 0x3b)
+    {
+        if (data[*position] == 0x2c)
+        {
+            return 0;
+        }
+        if (data[*position] != 0x21 || gif->size - *position < 2)
+        {
+            return 1;
+        }
+
+        // a graphic control extension is 4 bytes: packed flags, the delay and the transparent index
+        if (data[*position + 1] == 0xf9 && gif->size - *position >= 7 && data[*position + 2] == 4)
+        {
+            const BYTE *control = data + *position + 3;
+            if (delay != NULL)
+            {
+                *delay = control[1] | control[2] << 8;
+            }
+            if (disposal != NULL)
+            {
+                *disposal = control[0] >> 2 & 7;
+            }
+            if (transparent != NULL)
+            {
+                *transparent = (control[0] & 1) != 0 ? control[3] : -1;
+            }
+        }
+        *position += 2;
+        if (skipSubBlocks(gif, position) != 0)
+        {
+            return 1;
+        }
+    }
+    return -1;
+}
+
+// moves position past a run of sub-blocks and the empty one that ends them, returns 1 if they run past the
+// end of the file
+int skipSubBlocks (ANIMATION *gif, size_t *position)
+{
+    while (*position < gif->size && gif->data[*position] != 0)
+    {
+        *position += 1 + gif->data[*position];
+    }
+    if (*position >= gif->size)
+    {
+        return 1;
+    }
+    (*position)++;
+    return 0;
+}
+
+// decodes the next frame of an animation onto its canvas, over what the last one left once that's been
+// disposed of, returns 1 if the frame is broken (indices cut short only leave the rest of it undrawn)
+int nextAnimationFrame (ANIMATION *gif)
+{
+    int delay;
+    int disposal;
+    int transparent;
+    if (findImage(gif, &gif->position, &delay, &disposal, &transparent) != 0 || gif->size - gif->position < 11)
+    {
+        return 1;
+    }
+    disposeFrame(gif);
+
+    // the frame's rectangle and its own palette, if it has one
+    const BYTE *descriptor = gif->data + gif->position;
+    long left = descriptor[1] | descriptor[2] << 8;
+    long top = descriptor[3] | descriptor[4] << 8;
+    long width = descriptor[5] | descriptor[6] << 8;
+    long height = descriptor[7] | descriptor[8] << 8;
+    BYTE packed = descriptor[9];
+    bool interlaced = (packed & 0x40) != 0;
+    gif->position += 10;
+
+    BYTE palette[256][3] = {{0}};
+    if ((packed & 0x80) != 0)
+    {
+        int colours = 2 << (packed & 7);
+        if (gif->size - gif->position < 3 * (size_t) colours)
+        {
+            return 1;
+        }
+        for (int i = 0; i < colours; i++)
+        {
+            const BYTE *entry = gif->data + gif->position + 3 * i;
+            palette[i][0] = entry[2];
+            palette[i][1] = entry[1];
+            palette[i][2] = entry[0];
+        }
+        gif->position += 3 * colours;
+    }
+    else
+    {
+        memcpy(palette, gif->palette, sizeof(palette));
+    }
+
+    // a frame can't reach outside the logical screen, so it's clipped to it
+    if (left > gif->width)
+    {
+        left = gif->width;
+    }
+    if (top > gif->height)
+    {
+        top = gif->height;
+    }
+    long drawnWidth = left + width > gif->width ? gif->width - left : width;
+    long drawnHeight = top + height > gif->height ? gif->height - top : height;
+
+    // disposal 3 puts the canvas back to how it was before this frame
+    if (disposal == 3)
+    {
+        if (gif->saved == NULL)
+        {
+            gif->saved = malloc(gif->stride * gif->height);
+            if (gif->saved == NULL)
+            {
+                return 1;
+            }
+        }
+        memcpy(gif->saved, gif->canvas, gif->stride * gif->height);
+    }
+    gif->disposal = disposal;
+    gif->left = left;
+    gif->top = top;
+    gif->frameWidth = drawnWidth;
+    gif->frameHeight = drawnHeight;
+
+    if (gif->position >= gif->size)
+    {
+        return 1;
+    }
+    int minimumBits = gif->data[gif->position++];
+    if ((size_t) (width * height) > gif->indicesSize)
+    {
+        BYTE *grown = realloc(gif->indices, width * height);
+        if (grown == NULL)
+        {
+            return 1;
+        }
+        gif->indices = grown;
+        gif->indicesSize = width * height;
+    }
+    long decoded = 0;
+    int status = decodeLZW(gif, minimumBits, width * height, &decoded);
+
+    // interlaced rows come in four passes: every 8th from 0, every 8th from 4, every 4th from 2 and every
+    // 2nd from 1
+    static const int passStart[4] = {0, 4, 2, 1};
+    static const int passStep[4] = {8, 8, 4, 2};
+    long row = 0;
+    for (int pass = 0; pass < (interlaced ? 4 : 1) && status == 0; pass++)
+    {
+        for (long y = interlaced ? passStart[pass] : 0; y < height; y += interlaced ? passStep[pass] : 1, row++)
+        {
+            if (y >= drawnHeight || row * width >= decoded)
+            {
+                continue;
+            }
+            const BYTE *source = gif->indices + row * width;
+            BYTE *pixels = gif->canvas + (top + y) * gif->stride + 3 * left;
+            long count = decoded - row * width < drawnWidth ? decoded - row * width : drawnWidth;
+            for (long x = 0; x < count; x++)
+            {
+                if (source[x] != transparent)
+                {
+                    memcpy(pixels + 3 * x, palette[source[x]], 3);
+                }
+            }
+        }
+    }
+
+    gif->frame++;
+    return status;
+}
+
+// decodes the LZW coded indices of a frame (up to count of them) from the sub-blocks at the animation's
+// position into its indices, leaving position past them, returns 1 if the codes are broken, while codes
+// that stop early (without an end code) just leave fewer indices decoded
+int decodeLZW (ANIMATION *gif, int minimumBits, long count, long *decoded)
+{
+    if (minimumBits < 2 || minimumBits > 8)
+    {
+        return 1;
+    }
+
+    // every code past the clear and end codes is an earlier code and one more index, whose strings are
+    // written out backwards from their last index
+    short *prefix = gif->prefix;
+    BYTE *suffix = gif->suffix;
+    BYTE *first = gif->first;
+    short *length = gif->length;
+    int clear = 1 << minimumBits;
+    for (int code = 0; code < clear; code++)
+    {
+        prefix[code] = -1;
+        suffix[code] = code;
+        first[code] = code;
+        length[code] = 1;
+    }
+
+    const BYTE *data = gif->data;
+    size_t position = gif->position;
+    size_t blockLeft = 0;
+    uint32_t bits = 0;
+    int bitCount = 0;
+    int width = minimumBits + 1;
+    int next = clear + 2;
+    int previous = -1;
+    long done = 0;
+    int status = 0;
+    while (true)
+    {
+        // codes run on from one sub-block to the next
+        bool ended = false;
+        while (bitCount < width && !ended)
+        {
+            if (blockLeft == 0)
+            {
+                if (position >= gif->size || data[position] == 0)
+                {
+                    ended = true;
+                    break;
+                }
+                blockLeft = data[position++];
+            }
+            if (position >= gif->size)
+            {
+                ended = true;
+                break;
+            }
+            bits |= (uint32_t) data[position++] << bitCount;
+            bitCount += 8;
+            blockLeft--;
+        }
+        if (ended)
+        {
+            break;
+        }
+        int code = bits & ((1 << width) - 1);
+        bits >>= width;
+        bitCount -= width;
+
+        if (code == clear)
+        {
+            width = minimumBits + 1;
+            next = clear + 2;
+            previous = -1;
+            continue;
+        }
+        if (code == clear + 1)
+        {
+            break;
+        }
+        if (code > next || (code == next && previous < 0) || (previous < 0 && code >= clear))
+        {
+            status = 1;
+            break;
+        }
+
+        // a code one past the last is the previous string and its own first index
+        if (previous >= 0 && next < 4096)
+        {
+            prefix[next] = previous;
+            suffix[next] = code == next ? first[previous] : first[code];
+            first[next] = first[previous];
+            length[next] = length[previous] + 1;
+            next++;
+            if (next == 1 << width && width < 12)
+            {
+                width++;
+            }
+        }
+        previous = code;
+
+        // write the string out backwards, leaving off anything past count
+        long end = done + length[code];
+        for (int c = code; c >= 0; c = prefix[c])
+        {
+            end--;
+            if (end < count)
+            {
+                gif->indices[end] = suffix[c];
+            }
+        }
+        done += length[code];
+    }
+
+    // whatever is left of the sub-blocks is skipped
+    gif->position = position;
+    if (blockLeft > 0)
+    {
+        gif->position += blockLeft;
+    }
+    if (gif->position > gif->size || skipSubBlocks(gif, &gif->position) != 0)
+    {
+        gif->position = gif->size;
+    }
+    *decoded = done < count ? done : count;
+    return status;
+}
+
+// disposes of the last frame drawn, before the next one is drawn: 2 puts the background back under its
+// rectangle, 3 puts back the canvas from before it and anything else leaves it there
+void disposeFrame (ANIMATION *gif)
+{
+    if (gif->disposal == 2)
+    {
+        fillCanvas(gif, gif->left, gif->top, gif->frameWidth, gif->frameHeight);
+    }
+    else if (gif->disposal == 3 && gif->saved != NULL)
+    {
+        memcpy(gif->canvas, gif->saved, gif->stride * gif->height);
+    }
+    gif->disposal = 0;
+}
+
+// fills a rectangle of the canvas with the background colour
+void fillCanvas (ANIMATION *gif, long left, long top, long width, long height)
+{
+    BYTE colour[3] = {gif->background.rgbtBlue, gif->background.rgbtGreen, gif->background.rgbtRed};
+    for (long y = top; y < top + height; y++)
+    {
+        fillPixels(gif->canvas + y * gif->stride + 3 * left, colour, width);
+    }
+}
+
+// works out the colour of every LED from the frame on the canvas, returning the exit status for it
+int convertCanvas (ANIMATION *gif, char *infile, RGBTRIPLE *led, OPTIONS *options, WORKSPACE *space)
+{
+    STATS image = {.images = 1};
+    double mark = now();
+
+    // the canvas is a top-down 24-bit BMP without its headers
+    BITMAPINFOHEADER bi =
+    {
+        .biSize = sizeof(BITMAPINFOHEADER),
+        .biWidth = gif->width,
+        .biHeight = -gif->height,
+        .biPlanes = 1,
+        .biBitCount = 24,
+        .biCompression = BI_RGB,
+        .biXPelsPerMeter = 2835,
+        .biYPelsPerMeter = 2835
+    };
+    PIXELFORMAT format =
+    {
+        .bitCount = 24,
+        .compression = BI_RGB
+    };
+
+    SCANLINES lines;
+    openPixels(&lines, gif->canvas, &bi, &format);
+    bi.biHeight = lines.height;
+    return convertScanlines(&lines, &bi, infile, led, options, space, &image, &mark);
+}
+
+// frees everything an animation holds and unmaps its file
+void closeAnimation (ANIMATION *gif)
+{
+    if (gif->mapped)
+    {
+        munmap(gif->data, gif->size);
+    }
+    else
+    {
+        free(gif->data);
+    }
+    free(gif->delays);
+    free(gif->canvas);
+    free(gif->saved);
+    free(gif->indices);
+    gif->data = NULL;
+    gif->delays = NULL;
+    gif->canvas = NULL;
+    gif->saved = NULL;
+    gif->indices = NULL;
+}
+
+// points sumPixels, filterPixels and the other kernels at the widest vector versions the CPU supports
+void selectKernels (void)
+{
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        sumPixels = sumPixelsAVX2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        sumPixels = sumPixelsSSE2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        filterPixels = filterPixelsSSE2;
+        filterLines = filterLinesSSE2;
+    }
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        packPixels = packPixelsSSSE3;
+        swapPixels = swapPixelsSSSE3;
+    }
+#endif
+}
+
+// portable kernel, also finishes off whatever the vector kernels leave over
+void sumPixelsScalar (const BYTE *pixels, long count, long *blue, long *green, long *red)
+{
+    long b = 0;
+    long g = 0;
+    long r = 0;
+    for (long j = 0; j < count; j++)
+    {
+        b += pixels[3 * j];
+        g += pixels[3 * j + 1];
+        r += pixels[3 * j + 2];
+    }
+    *blue += b;
+    *green += g;
+    *red += r;
+}
+
+// portable filter kernel
+void filterPixelsScalar (const BYTE *pixels, const float *weights, int count, float *bgr)
+{
+    float b = 0;
+    float g = 0;
+    float r = 0;
+    for (int j = 0; j < count; j++)
+    {
+        b += weights[j] * pixels[3 * j];
+        g += weights[j] * pixels[3 * j + 1];
+        r += weights[j] * pixels[3 * j + 2];
+    }
+    bgr[0] += b;
+    bgr[1] += g;
+    bgr[2] += r;
+}
+
+// portable vertical filter kernel
+void filterLinesScalar (const float *lines, long stride, const float *weights, int count, int width, float *sum)
+{
+    memset(sum, 0, width * 4 * sizeof(float));
+    for (int t = 0; t < count; t++)
+    {
+        const float *line = lines + t * stride;
+        for (int i = 0; i < width * 4; i++)
+        {
+            sum[i] += weights[t] * line[i];
+        }
+    }
+}
+
+// palette indices, a whole byte of them at a time
+void expandIndices (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format)
+{
+    // a byte is one pixel, copied without going through memcpy
+    if (format->bitCount == 8)
+    {
+        for (long j = 0; j < width; j++)
+        {
+            const BYTE *colour = format->palette[stored[j]];
+            pixels[3 * j] = colour[0];
+            pixels[3 * j + 1] = colour[1];
+            pixels[3 * j + 2] = colour[2];
+        }
+        return;
+    }
+
+    long perByte = 8 / format->bitCount;
+    long j = 0;
+    for (long i = 0; j < width; i++)
+    {
+        long count = width - j < perByte ? width - j : perByte;
+        memcpy(pixels + 3 * j, format->expand[stored[i]], 3 * count);
+        j += count;
+    }
+}
+
+// portable RGB to BGR kernel
+void swapPixelsScalar (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format)
+{
+    (void) format;
+    for (long j = 0; j < width; j++)
+    {
+        pixels[3 * j] = stored[3 * j + 2];
+        pixels[3 * j + 1] = stored[3 * j + 1];
+        pixels[3 * j + 2] = stored[3 * j];
+    }
+}
+
+// netpbm samples of any maxval, grey or RGB, each scaled to 8 bits and alpha blended in when asked for
+void unpackSamples (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format)
+{
+    const BYTE background[3] = {format->background.rgbtBlue, format->background.rgbtGreen,
+                                format->background.rgbtRed};
+    int samples = format->samples;
+    DWORD maxval = format->maxval;
+    bool alpha = samples % 2 == 0;
+    for (long j = 0; j < width; j++)
+    {
+        int values[4];
+        for (int s = 0; s < samples; s++)
+        {
+            const BYTE *p = stored + (j * samples + s) * format->sampleBytes;
+            DWORD value = format->sampleBytes == 2 ? (DWORD) p[0] << 8 | p[1] : p[0];
+            values[s] = ((value < maxval ? value : maxval) * 255 + maxval / 2) / maxval;
+        }
+
+        // blue, green and red
+        int colour[3] = {values[samples < 3 ? 0 : 2], values[samples < 3 ? 0 : 1], values[0]};
+        int opacity = alpha ? values[samples - 1] : 255;
+        for (int c = 0; c < 3; c++)
+        {
+            pixels[3 * j + c] = !alpha || !format->blend ? colour[c] :
+                                (colour[c] * opacity + background[c] * (255 - opacity) + 127) / 255;
+        }
+    }
+}
+
+// portable 32-bit to 24-bit kernel
+void packPixelsScalar (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format)
+{
+    (void) format;
+    for (long j = 0; j < width; j++)
+    {
+        pixels[3 * j] = stored[4 * j];
+        pixels[3 * j + 1] = stored[4 * j + 1];
+        pixels[3 * j + 2] = stored[4 * j + 2];
+    }
+}
+
+// BGRA pixels with alpha in the top byte, blended into the background colour
+void blendPixels (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format)
+{
+    const BYTE background[3] = {format->background.rgbtBlue, format->background.rgbtGreen,
+                                format->background.rgbtRed};
+    for (long j = 0; j < width; j++)
+    {
+        int alpha = stored[4 * j + 3];
+        for (int c = 0; c < 3; c++)
+        {
+            pixels[3 * j + c] = (stored[4 * j + c] * alpha + background[c] * (255 - alpha) + 127) / 255;
+        }
+    }
+}
+
+// 32-bit pixels under any masks, each channel scaled to 8 bits and alpha blended in when asked for
+void unmaskPixels (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format)
+{
+    const BYTE background[3] = {format->background.rgbtBlue, format->background.rgbtGreen,
+                                format->background.rgbtRed};
+    bool blend = format->blend && format->bits[3] > 0;
+    for (long j = 0; j < width; j++)
+    {
+        // pixels are little-endian
+        const BYTE *p = stored + 4 * j;
+        DWORD pixel = p[0] | p[1] << 8 | p[2] << 16 | (DWORD) p[3] << 24;
+
+        int channels[4];
+        for (int c = 0; c < 4; c++)
+        {
+            DWORD value = (pixel & format->masks[c]) >> format->shifts[c];
+            int bits = format->bits[c];
+            channels[c] = bits == 0 ? 255 : bits >= 8 ? value >> (bits - 8) : value * 255 / ((1u << bits) - 1);
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            pixels[3 * j + c] = blend ? (channels[c] * channels[3] + background[c] * (255 - channels[3]) + 127) / 255
+                                      : channels[c];
+        }
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+// channel (0 blue, 1 green, 2 red) of each byte in a run of packed BGR pixels, the pattern repeats every
+// 48 bytes so any vector starting a multiple of 48 bytes into the run can be masked with it
+static const BYTE channelOf[96] =
+{
+    0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1,
+    2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0,
+    1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2
+};
+
+// 16 pixels (3 vectors) per step: blue and green bytes are masked out and summed with psadbw, red is
+// whatever is left of the sum of all bytes
+__attribute__((target("sse2")))
+void sumPixelsSSE2 (const BYTE *pixels, long count, long *blue, long *green, long *red)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i blueMask[3];
+    __m128i greenMask[3];
+    for (int v = 0; v < 3; v++)
+    {
+        __m128i channels = _mm_loadu_si128((const __m128i *) (channelOf + 16 * v));
+        blueMask[v] = _mm_cmpeq_epi8(channels, _mm_set1_epi8(0));
+        greenMask[v] = _mm_cmpeq_epi8(channels, _mm_set1_epi8(1));
+    }
+
+    __m128i b = zero;
+    __m128i g = zero;
+    __m128i all = zero;
+    long j = 0;
+    for (; j + 16 <= count; j += 16)
+    {
+        const BYTE *p = pixels + 3 * j;
+        for (int v = 0; v < 3; v++)
+        {
+            __m128i bytes = _mm_loadu_si128((const __m128i *) (p + 16 * v));
+            b = _mm_add_epi64(b, _mm_sad_epu8(_mm_and_si128(bytes, blueMask[v]), zero));
+            g = _mm_add_epi64(g, _mm_sad_epu8(_mm_and_si128(bytes, greenMask[v]), zero));
+            all = _mm_add_epi64(all, _mm_sad_epu8(bytes, zero));
+        }
+    }
+
+    long long lanes[3][2];
+    _mm_storeu_si128((__m128i *) lanes[0], b);
+    _mm_storeu_si128((__m128i *) lanes[1], g);
+    _mm_storeu_si128((__m128i *) lanes[2], all);
+    long blueTotal = lanes[0][0] + lanes[0][1];
+    long greenTotal = lanes[1][0] + lanes[1][1];
+    *blue += blueTotal;
+    *green += greenTotal;
+    *red += lanes[2][0] + lanes[2][1] - blueTotal - greenTotal;
+
+    sumPixelsScalar(pixels + 3 * j, count - j, blue, green, red);
+}
+
+// same as sumPixelsSSE2 with 32 pixels per step
+__attribute__((target("avx2")))
+void sumPixelsAVX2 (const BYTE *pixels, long count, long *blue, long *green, long *red)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i blueMask[3];
+    __m256i greenMask[3];
+    for (int v = 0; v < 3; v++)
+    {
+        __m256i channels = _mm256_loadu_si256((const __m256i *) (channelOf + 32 * v));
+        blueMask[v] = _mm256_cmpeq_epi8(channels, _mm256_set1_epi8(0));
+        greenMask[v] = _mm256_cmpeq_epi8(channels, _mm256_set1_epi8(1));
+    }
+
+    __m256i b = zero;
+    __m256i g = zero;
+    __m256i all = zero;
+    long j = 0;
+    for (; j + 32 <= count; j += 32)
+    {
+        const BYTE *p = pixels + 3 * j;
+        for (int v = 0; v < 3; v++)
+        {
+            __m256i bytes = _mm256_loadu_si256((const __m256i *) (p + 32 * v));
+            b = _mm256_add_epi64(b, _mm256_sad_epu8(_mm256_and_si256(bytes, blueMask[v]), zero));
+            g = _mm256_add_epi64(g, _mm256_sad_epu8(_mm256_and_si256(bytes, greenMask[v]), zero));
+            all = _mm256_add_epi64(all, _mm256_sad_epu8(bytes, zero));
+        }
+    }
+
+    // fold down to 128 bits and take one more 16 pixel step if there is room, staying in VEX encoded
+    // instructions here rather than calling sumPixelsSSE2 avoids an AVX to SSE transition penalty
+    __m128i b128 = _mm_add_epi64(_mm256_castsi256_si128(b), _mm256_extracti128_si256(b, 1));
+    __m128i g128 = _mm_add_epi64(_mm256_castsi256_si128(g), _mm256_extracti128_si256(g, 1));
+    __m128i all128 = _mm_add_epi64(_mm256_castsi256_si128(all), _mm256_extracti128_si256(all, 1));
+    if (j + 16 <= count)
+    {
+        const BYTE *p = pixels + 3 * j;
+        const __m128i zero128 = _mm_setzero_si128();
+        for (int v = 0; v < 3; v++)
+        {
+            // the 48 byte mask pattern restarts here, so vector v uses the masks for bytes 16 * v onwards
+            __m128i channels = _mm_loadu_si128((const __m128i *) (channelOf + 16 * v));
+            __m128i bytes = _mm_loadu_si128((const __m128i *) (p + 16 * v));
+            b128 = _mm_add_epi64(b128, _mm_sad_epu8(_mm_and_si128(bytes, _mm_cmpeq_epi8(channels, _mm_set1_epi8(0))),
+                                                    zero128));
+            g128 = _mm_add_epi64(g128, _mm_sad_epu8(_mm_and_si128(bytes, _mm_cmpeq_epi8(channels, _mm_set1_epi8(1))),
+                                                    zero128));
+            all128 = _mm_add_epi64(all128, _mm_sad_epu8(bytes, zero128));
+        }
+        j += 16;
+    }
+
+    long long lanes[3][2];
+    _mm_storeu_si128((__m128i *) lanes[0], b128);
+    _mm_storeu_si128((__m128i *) lanes[1], g128);
+    _mm_storeu_si128((__m128i *) lanes[2], all128);
+    long blueTotal = lanes[0][0] + lanes[0][1];
+    long greenTotal = lanes[1][0] + lanes[1][1];
+    *blue += blueTotal;
+    *green += greenTotal;
+    *red += lanes[2][0] + lanes[2][1] - blueTotal - greenTotal;
+
+    sumPixelsScalar(pixels + 3 * j, count - j, blue, green, red);
+}
+
+// four pixels (taps) per step from one 16 byte load: their 12 bytes widen to three vectors of floats, b0 g0 r0
+// b1, g1 r1 b2 g2 and r2 b3 g3 r3, that are multiplied by the four weights spread out the same way, and the
+// lanes of each channel are only added up at the end, the last few taps (where a 16 byte load could read
+// past the last pixel of a mapping) take one pixel per step with its channels in the lanes of one vector
+__attribute__((target("sse2")))
+void filterPixelsSSE2 (const BYTE *pixels, const float *weights, int count, float *bgr)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128 sums[3] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()};
+    int j = 0;
+    for (; j + 6 <= count; j += 4)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i *) (pixels + 3 * j));
+        __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        __m128i high = _mm_unpackhi_epi8(bytes, zero);
+        __m128 w = _mm_loadu_ps(weights + j);
+        sums[0] = _mm_add_ps(sums[0], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)),
+                                                 _mm_shuffle_ps(w, w, _MM_SHUFFLE(1, 0, 0, 0))));
+        sums[1] = _mm_add_ps(sums[1], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)),
+                                                 _mm_shuffle_ps(w, w, _MM_SHUFFLE(2, 2, 1, 1))));
+        sums[2] = _mm_add_ps(sums[2], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)),
+                                                 _mm_shuffle_ps(w, w, _MM_SHUFFLE(3, 3, 3, 2))));
+    }
+
+    __m128 sum = _mm_setzero_ps();
+    for (; j < count; j++)
+    {
+        // the three bytes are put together by hand so the last pixel of a mapping is never read past
+        const BYTE *p = pixels + 3 * j;
+        __m128i bytes = _mm_cvtsi32_si128(p[0] | p[1] << 8 | p[2] << 16);
+        __m128i lanes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(lanes), _mm_set1_ps(weights[j])));
+    }
+
+    float lanes[3][4];
+    _mm_storeu_ps(lanes[0], sums[0]);
+    _mm_storeu_ps(lanes[1], sums[1]);
+    _mm_storeu_ps(lanes[2], sums[2]);
+    sum = _mm_add_ps(sum, _mm_setr_ps(lanes[0][0] + lanes[0][3] + lanes[1][2] + lanes[2][1],
+                                      lanes[0][1] + lanes[1][0] + lanes[1][3] + lanes[2][2],
+                                      lanes[0][2] + lanes[1][1] + lanes[2][0] + lanes[2][3], 0));
+    _mm_storeu_ps(bgr, _mm_add_ps(_mm_loadu_ps(bgr), sum));
+}
+
+// two pixels per step, each a vector of four floats, kept in registers over all count scanlines before they
+// are stored, so sum is written once instead of once per scanline
+__attribute__((target("sse2")))
+void filterLinesSSE2 (const float *lines, long stride, const float *weights, int count, int width, float *sum)
+{
+    int x = 0;
+    for (; x + 2 <= width; x += 2)
+    {
+        __m128 first = _mm_setzero_ps();
+        __m128 second = _mm_setzero_ps();
+        for (int t = 0; t < count; t++)
+        {
+            const float *line = lines + t * stride + 4 * x;
+            __m128 w = _mm_set1_ps(weights[t]);
+            first = _mm_add_ps(first, _mm_mul_ps(w, _mm_loadu_ps(line)));
+            second = _mm_add_ps(second, _mm_mul_ps(w, _mm_loadu_ps(line + 4)));
+        }
+        _mm_storeu_ps(sum + 4 * x, first);
+        _mm_storeu_ps(sum + 4 * x + 4, second);
+    }
+    if (x < width)
+    {
+        __m128 last = _mm_setzero_ps();
+        for (int t = 0; t < count; t++)
+        {
+            last = _mm_add_ps(last, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(lines + t * stride + 4 * x)));
+        }
+        _mm_storeu_ps(sum + 4 * x, last);
+    }
+}
+
+// four pixels per step, shuffled down from 16 bytes to 12, the 4 bytes stored past them are overwritten by
+// the next step so the last steps are left to the scalar kernel
+__attribute__((target("ssse3")))
+void packPixelsSSSE3 (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    long j = 0;
+    for (; j + 6 <= width; j += 4)
+    {
+        __m128i bgrx = _mm_loadu_si128((const __m128i *) (stored + 4 * j));
+        _mm_storeu_si128((__m128i *) (pixels + 3 * j), _mm_shuffle_epi8(bgrx, shuffle));
+    }
+    packPixelsScalar(stored + 4 * j, pixels + 3 * j, width - j, format);
+}
+
+// five pixels per step, the red and blue of each swapped within 16 bytes, the byte stored past them is
+// overwritten by the next step so the last steps are left to the scalar kernel
+__attribute__((target("ssse3")))
+void swapPixelsSSSE3 (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format)
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+    long j = 0;
+    for (; j + 6 <= width; j += 5)
+    {
+        __m128i rgb = _mm_loadu_si128((const __m128i *) (stored + 3 * j));
+        _mm_storeu_si128((__m128i *) (pixels + 3 * j), _mm_shuffle_epi8(rgb, shuffle));
+    }
+    swapPixelsScalar(stored + 3 * j, pixels + 3 * j, width - j, format);
+}
+#endif
+
+// averages the scanlines of a bi sized image into the scaled image using the given number of threads, every
+// infile pixel counts towards the pixels of the scaled image it overlaps in proportion to the area they share
+// (or, for other kernels, by the kernel's filter), returns 1 if the scanlines end early or 2 if we run out
+// of memory
+int downscale (SCANLINES *lines, BITMAPINFOHEADER *bi, RGBTRIPLE scaled[][SCALED_MAX_WIDTH], int kernel,
+               int threads, WORKSPACE *space)
+{
+    if (kernel != KERNEL_AREA)
+    {
+        return downscaleFiltered(lines, bi, scaled, kernel, threads, space);
+    }
+
+    const RESAMPLE *resample = prepareResample(space, bi);
+
+    BANDS bands =
+    {
+        .lines = lines,
+        // figure out how many rows and columns of pixels from infile will make up 1 pixel in scaled image
+        .pxColumns = bi->biWidth / layout.width,
+        .pxRows = bi->biHeight / layout.height,
+        .rows = resample->rows,
+        .maxRows = resample->maxRows,
+        .resample = resample,
+        .scaled = scaled
+    };
+
+    // sizes that divide evenly only need whole runs of pixels added up
+    return runBands(&bands, threads, resample->exact ? downscaleBands : resampleBands, &space->band);
+}
+
+// worker that averages bands of an exact geometry into their row of the scaled image until there are none left
+void *downscaleBands (void *arg)
+{
+    BANDS *bands = ((WORKER *) arg)->bands;
+    long pxColumns = bands->pxColumns;
+    long pxRows = bands->pxRows;
+    int width = layout.width;
+
+    BYTE *buffer;
+    if (allocateBand(arg, &buffer) != 0)
+    {
+        return NULL;
+    }
+
+    int band;
+    const BYTE *scanlines;
+    while ((scanlines = claimBand(bands, buffer, &band)) != NULL)
+    {
+        long red[SCALED_MAX_WIDTH] = {0};
+        long blue[SCALED_MAX_WIDTH] = {0};
+        long green[SCALED_MAX_WIDTH] = {0};
+
+        // iterate over the band's scanlines
+        for (long i = 0; i < pxRows; i++)
+        {
+            const RGBTRIPLE *scanline = (const RGBTRIPLE *) (scanlines + i * bands->lines->step);
+
+            // sum the RBG values of each run of pxColumns pixels into the pixel they will make up in the scaled
+            // image
+            for (int x = 0; x < width; x++)
+            {
+                sumPixels((const BYTE *) (scanline + x * pxColumns), pxColumns, &blue[x], &green[x], &red[x]);
+            }
+        }
+
+        // average the RGB values gathered above into this band's row of the scaled image
+        for (int x = 0; x < width; x++)
+        {
+            bands->scaled[band][x].rgbtRed = red[x] / (pxColumns * pxRows);
+            bands->scaled[band][x].rgbtGreen = green[x] / (pxColumns * pxRows);
+            bands->scaled[band][x].rgbtBlue = blue[x] / (pxColumns * pxRows);
+        }
+    }
+
+    return NULL;
+}
+
+// worker that resamples bands into their row of the scaled image until there are none left: every pixel of
+// the scaled image adds up the infile pixels it covers weighted by how much of them it covers, in whole units
+// of 1/layout.width by 1/layout.height of a pixel so the only rounding is the final division by the area
+void *resampleBands (void *arg)
+{
+    BANDS *bands = ((WORKER *) arg)->bands;
+    const RESAMPLE *resample = bands->resample;
+    long area = resample->width * resample->height;
+
+    BYTE *buffer;
+    if (allocateBand(arg, &buffer) != 0)
+    {
+        return NULL;
+    }
+
+    int band;
+    const BYTE *scanlines;
+    while ((scanlines = claimBand(bands, buffer, &band)) != NULL)
+    {
+        const COVERAGE *rows = &resample->rows[band];
+
+        // weights are the same on every scanline, so scanlines in the middle of the band (covered whole) are
+        // added up as they are and only weighted once at the end, the ones at either end are weighted alone
+        COLUMNSUMS middle = {0};
+        long total[3][SCALED_MAX_WIDTH] = {{0}};
+
+        // iterate over the band's scanlines
+        for (long i = rows->first; i <= rows->last; i++)
+        {
+            const BYTE *scanline = scanlines + (i - rows->first) * bands->lines->step;
+            if (i != rows->first && i != rows->last)
+            {
+                sumColumns(scanline, resample->columns, &middle);
+                continue;
+            }
+
+            COLUMNSUMS end = {0};
+            sumColumns(scanline, resample->columns, &end);
+            weighColumns(&end, resample->columns, i == rows->first ? rows->lead : rows->trail, total);
+        }
+        weighColumns(&middle, resample->columns, layout.height, total);
+
+        // every pixel of the scaled image covers width x height units
+        for (int x = 0; x < layout.width; x++)
+        {
+            bands->scaled[band][x].rgbtBlue = total[0][x] / area;
+            bands->scaled[band][x].rgbtGreen = total[1][x] / area;
+            bands->scaled[band][x].rgbtRed = total[2][x] / area;
+        }
+    }
+
+    return NULL;
+}
+
+// adds the pixels of one scanline under every column of the scaled image onto sums
+void sumColumns (const BYTE *scanline, const COVERAGE *columns, COLUMNSUMS *sums)
+{
+    int width = layout.width;
+    for (int x = 0; x < width; x++)
+    {
+        const COVERAGE *coverage = &columns[x];
+        const BYTE *lead = scanline + 3 * coverage->first;
+        const BYTE *trail = scanline + 3 * coverage->last;
+
+        // a column within a single pixel adds it as the trail as well, with a weight of 0
+        for (int k = 0; k < 3; k++)
+        {
+            sums->lead[k][x] += lead[k];
+            sums->trail[k][x] += trail[k];
+        }
+
+        if (coverage->last - coverage->first > 1)
+        {
+            sumPixels(lead + 3, coverage->last - coverage->first - 1,
+                      &sums->inner[0][x], &sums->inner[1][x], &sums->inner[2][x]);
+        }
+    }
+}
+
+// weights sums by the coverage of every column and by rowWeight and adds them onto total
+void weighColumns (const COLUMNSUMS *sums, const COVERAGE *columns, long rowWeight, long total[][SCALED_MAX_WIDTH])
+{
+    int width = layout.width;
+    for (int k = 0; k < 3; k++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            total[k][x] += (sums->inner[k][x] * width + sums->lead[k][x] * columns[x].lead +
+                            sums->trail[k][x] * columns[x].trail) * rowWeight;
+        }
+    }
+}
+
+// returns the resampling for a bi sized infile, working it out only when the geometry differs from the last
+// image this workspace read
+const RESAMPLE *prepareResample (WORKSPACE *space, BITMAPINFOHEADER *bi)
+{
+    RESAMPLE *resample = &space->resample;
+    if (resample->width == bi->biWidth && resample->height == bi->biHeight)
+    {
+        return resample;
+    }
+
+    resample->width = bi->biWidth;
+    resample->height = bi->biHeight;
+    measureCoverage(resample->columns, layout.width, resample->width);
+    measureCoverage(resample->rows, layout.height, resample->height);
+
+    resample->maxRows = 0;
+    for (int y = 0; y < layout.height; y++)
+    {
+        long count = resample->rows[y].last - resample->rows[y].first + 1;
+        if (count > resample->maxRows)
+        {
+            resample->maxRows = count;
+        }
+    }
+
+    resample->exact = resample->width % layout.width == 0 && resample->height % layout.height == 0;
+    return resample;
+}
+
+// works out which of size infile pixels make up each of scaledSize pixels along one axis of the scaled image
+void measureCoverage (COVERAGE *coverage, int scaledSize, long size)
+{
+    for (int x = 0; x < scaledSize; x++)
+    {
+        // in units of 1/scaledSize of an infile pixel, pixel x of the scaled image runs from x * size up
+        // to (x + 1) * size and infile pixel i from i * scaledSize up to (i + 1) * scaledSize
+        long start = x * size;
+        long end = (x + 1) * size;
+
+        coverage[x].first = start / scaledSize;
+        coverage[x].last = (end - 1) / scaledSize;
+        if (coverage[x].first == coverage[x].last)
+        {
+            coverage[x].lead = end - start;
+            coverage[x].trail = 0;
+        }
+        else
+        {
+            coverage[x].lead = (coverage[x].first + 1) * scaledSize - start;
+            coverage[x].trail = end - coverage[x].last * scaledSize;
+        }
+    }
+}
+
+// filters the scanlines of a bi sized image into the scaled image with a kernel's separable filter: threads
+// filter bands of scanlines horizontally down to layout.width columns, then the filtered scanlines are
+// filtered vertically into the rows of the scaled image, returns 1 if the scanlines end early or 2 if we
+// run out of memory
+int downscaleFiltered (SCANLINES *lines, BITMAPINFOHEADER *bi, RGBTRIPLE scaled[][SCALED_MAX_WIDTH], int kernel,
+                       int threads, WORKSPACE *space)
+{
+    const FILTERS *filters = prepareFilters(space, bi, kernel);
+    if (filters == NULL || growBuffer(&space->filtered, (size_t) bi->biHeight * layout.width * 4 * sizeof(float)) != 0)
+    {
+        return 2;
+    }
+
+    BANDS bands =
+    {
+        .lines = lines,
+        .rows = filters->bands,
+        .maxRows = filters->maxRows,
+        .filters = filters,
+        .filtered = (float *) space->filtered.data
+    };
+    int status = runBands(&bands, threads, filterBands, &space->band);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    filterColumns(filters, bands.filtered, scaled);
+    return 0;
+}
+
+// worker that filters the scanlines of bands horizontally until there are none left, each scanline becomes
+// layout.width pixels of four floats (blue, green, red and a spare) in its own slot of the filtered scanlines
+void *filterBands (void *arg)
+{
+    BANDS *bands = ((WORKER *) arg)->bands;
+    const FILTERBANK *columns = &bands->filters->columns;
+    int width = layout.width;
+
+    BYTE *buffer;
+    if (allocateBand(arg, &buffer) != 0)
+    {
+        return NULL;
+    }
+
+    int band;
+    const BYTE *scanlines;
+    while ((scanlines = claimBand(bands, buffer, &band)) != NULL)
+    {
+        const COVERAGE *rows = &bands->rows[band];
+        for (long i = rows->first; i <= rows->last; i++)
+        {
+            const BYTE *scanline = scanlines + (i - rows->first) * bands->lines->step;
+            float *filtered = bands->filtered + i * width * 4;
+            for (int x = 0; x < width; x++)
+            {
+                filtered[4 * x] = 0;
+                filtered[4 * x + 1] = 0;
+                filtered[4 * x + 2] = 0;
+                filtered[4 * x + 3] = 0;
+                filterPixels(scanline + 3 * columns->first[x], columns->weights + x * columns->taps,
+                             columns->count[x], &filtered[4 * x]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// vertical pass: weighs the filtered scanlines under each row of the scaled image into it, all the pixels of
+// a row at once
+void filterColumns (const FILTERS *filters, const float *filtered, RGBTRIPLE scaled[][SCALED_MAX_WIDTH])
+{
+    const FILTERBANK *rows = &filters->rows;
+    int width = layout.width;
+    for (int y = 0; y < layout.height; y++)
+    {
+        float sum[SCALED_MAX_WIDTH * 4];
+        filterLines(filtered + rows->first[y] * width * 4, width * 4, rows->weights + y * rows->taps,
+                    rows->count[y], width, sum);
+
+        for (int x = 0; x < width; x++)
+        {
+            scaled[y][x].rgbtBlue = toByte(sum[4 * x]);
+            scaled[y][x].rgbtGreen = toByte(sum[4 * x + 1]);
+            scaled[y][x].rgbtRed = toByte(sum[4 * x + 2]);
+        }
+    }
+}
+
+// rounds a filtered colour to a byte, filters with negative lobes can overshoot either way
+BYTE toByte (float value)
+{
+    if (value <= 0)
+    {
+        return 0;
+    }
+    if (value >= 255)
+    {
+        return 255;
+    }
+    return value + 0.5f;
+}
+
+// returns the filters of kernel for a bi sized infile, working them out only when the geometry or kernel
+// differs from the last image this workspace filtered, returns NULL if we run out of memory
+const FILTERS *prepareFilters (WORKSPACE *space, BITMAPINFOHEADER *bi, int kernel)
+{
+    FILTERS *filters = &space->filters;
+    if (filters->kernel == kernel && filters->width == bi->biWidth && filters->height == bi->biHeight)
+    {
+        return filters;
+    }
+
+    // the area kernel never has filters, so it marks them as not worked out until they are
+    filters->kernel = KERNEL_AREA;
+    if (measureBank(&filters->columns, &kernels[kernel], layout.width, bi->biWidth) != 0 ||
+        measureBank(&filters->rows, &kernels[kernel], layout.height, bi->biHeight) != 0)
+    {
+        return NULL;
+    }
+
+    // bands of the horizontal pass just split the scanlines evenly, some are empty if there are few
+    filters->maxRows = 0;
+    for (int y = 0; y < layout.height; y++)
+    {
+        filters->bands[y].first = y * bi->biHeight / layout.height;
+        filters->bands[y].last = (y + 1) * bi->biHeight / layout.height - 1;
+        long count = filters->bands[y].last - filters->bands[y].first + 1;
+        if (count > filters->maxRows)
+        {
+            filters->maxRows = count;
+        }
+    }
+
+    filters->kernel = kernel;
+    filters->width = bi->biWidth;
+    filters->height = bi->biHeight;
+    return filters;
+}
+
+// works out kernel's filter for each of scaledSize pixels along one axis of the scaled image from size infile
+// pixels, returns 2 if we run out of memory
+int measureBank (FILTERBANK *bank, const KERNEL *kernel, int scaledSize, long size)
+{
+    // when shrinking, the filter is stretched over the infile pixels that make up a pixel of the scaled image
+    double scale = (double) size / scaledSize;
+    double stretch = scale > 1 ? scale : 1;
+    double support = kernel->radius * stretch;
+
+    int taps = (int) ceil(2 * support) + 3;
+    float *weights = realloc(bank->weights, (size_t) scaledSize * taps * sizeof(float));
+    if (weights == NULL)
+    {
+        return 2;
+    }
+    bank->weights = weights;
+    bank->taps = taps;
+
+    for (int x = 0; x < scaledSize; x++)
+    {
+        // infile pixel i is centred on i + 0.5, pixels past the edges are left out
+        double centre = (x + 0.5) * scale;
+        long first = (long) floor(centre - support);
+        long last = (long) ceil(centre + support);
+        first = first < 0 ? 0 : first;
+        last = last > size - 1 ? size - 1 : last;
+
+        float *w = weights + x * taps;
+        double total = 0;
+        for (long i = first; i <= last; i++)
+        {
+            w[i - first] = kernel->weight((i + 0.5 - centre) / stretch);
+            total += w[i - first];
+        }
+
+        // a filter that cancels out to nothing falls back to the nearest pixel
+        if (total <= 0)
+        {
+            first = centre < size ? (long) centre : size - 1;
+            last = first;
+            w[0] = 1;
+            total = 1;
+        }
+
+        for (long i = first; i <= last; i++)
+        {
+            w[i - first] /= total;
+        }
+        bank->first[x] = first;
+        bank->count[x] = last - first + 1;
+    }
+
+    return 0;
+}
+
+// tent filter, linear interpolation between neighbouring pixels
+double triangleWeight (double x)
+{
+    x = fabs(x);
+    return x < 1 ? 1 - x : 0;
+}
+
+// windowed sinc with 3 lobes
+double lanczosWeight (double x)
+{
+    if (x == 0)
+    {
+        return 1;
+    }
+    if (fabs(x) >= 3)
+    {
+        return 0;
+    }
+    return 3 * sin(M_PI * x) * sin(M_PI * x / 3) / (M_PI * M_PI * x * x);
+}
+
+// gaussian with a standard deviation of half a pixel
+double gaussianWeight (double x)
+{
+    return exp(-2 * x * x);
+}
+
+// returns the KERNEL_ number of the kernel called name, or -1 if there's no such kernel
+int findKernel (const char *name)
+{
+    for (int k = 0; k < (int) (sizeof(kernels) / sizeof(kernels[0])); k++)
+    {
+        if (strcmp(name, kernels[k].name) == 0)
+        {
+            return k;
+        }
+    }
+    return -1;
+}
+
+// frees a workspace along with all the memory it kept
+void freeWorkspace (WORKSPACE *space)
+{
+    free(space->band.data);
+    free(space->filtered.data);
+    free(space->filters.columns.weights);
+    free(space->filters.rows.weights);
+    free(space);
+}
+
+// averages the pixels of the scaled image that make up each LED
+void aggregateLEDs (RGBTRIPLE scaled[][SCALED_MAX_WIDTH], RGBTRIPLE *led)
+{
+    long redSum[LED_MAX_COUNT];
+    long greenSum[LED_MAX_COUNT];
+    long blueSum[LED_MAX_COUNT];
+    memset(redSum, 0, layout.ledCount * sizeof(long));
+    memset(greenSum, 0, layout.ledCount * sizeof(long));
+    memset(blueSum, 0, layout.ledCount * sizeof(long));
+    int ledNumber;
+
+    // iterate over scaled image's scanlines, top row first
+    for (int i = 0; i < layout.height; i++)
+    {
+        const int16_t *index = layout.index + i * layout.width;
+
+        // iterate over pixels in scanline
+        for (int j = 0; j < layout.width; j++)
+        {
+            RGBTRIPLE triple = scaled[layout.height - 1 - i][j];
+
+            // only save info on valid LEDs from the scaled image
+            ledNumber = index[j];
+            if (ledNumber != -1)
+            {
+                // sum RBG values for averaging later
+                redSum[ledNumber] += triple.rgbtRed;
+                greenSum[ledNumber] += triple.rgbtGreen;
+                blueSum[ledNumber] += triple.rgbtBlue;
+            }
+        }
+    }
+
+    for (int n = 0; n < layout.ledCount; n++)
+    {
+        led[n].rgbtRed = redSum[n] / layout.pixels[n];
+        led[n].rgbtGreen = greenSum[n] / layout.pixels[n];
+        led[n].rgbtBlue = blueSum[n] / layout.pixels[n];
+    }
+}
+
+// averages the scanlines of a bi sized image straight into the LEDs in one pass using the given number of
+// threads, with only one rounding step, returns 1 if the scanlines end early or 2 if we run out of memory,
+// an infile whose size doesn't divide evenly is resampled through the scaled image instead
+int gatherLEDs (SCANLINES *lines, BITMAPINFOHEADER *bi, RGBTRIPLE *led, int threads, WORKSPACE *space)
+{
+    const RESAMPLE *resample = prepareResample(space, bi);
+    if (!resample->exact)
+    {
+        RGBTRIPLE scaled[SCALED_MAX_HEIGHT][SCALED_MAX_WIDTH];
+        int status = downscale(lines, bi, scaled, KERNEL_AREA, threads, space);
+        if (status == 0)
+        {
+            aggregateLEDs(scaled, led);
+        }
+        return status;
+    }
+
+    long pxColumns = bi->biWidth / layout.width;
+    long pxRows = bi->biHeight / layout.height;
+
+    // the footprint only depends on the geometry, so consecutive images of the same size share it
+    FOOTPRINT *footprint = &space->footprint;
+    if (footprint->pxColumns != pxColumns || footprint->pxRows != pxRows)
+    {
+        measureFootprint(footprint, pxColumns, pxRows);
+    }
+
+    long redSum[LED_MAX_COUNT];
+    long greenSum[LED_MAX_COUNT];
+    long blueSum[LED_MAX_COUNT];
+    memset(redSum, 0, layout.ledCount * sizeof(long));
+    memset(greenSum, 0, layout.ledCount * sizeof(long));
+    memset(blueSum, 0, layout.ledCount * sizeof(long));
+
+    BANDS bands =
+    {
+        .lines = lines,
+        .pxColumns = pxColumns,
+        .pxRows = pxRows,
+        .rows = resample->rows,
+        .maxRows = resample->maxRows,
+        .footprint = footprint,
+        .redSum = redSum,
+        .greenSum = greenSum,
+        .blueSum = blueSum
+    };
+    int status = runBands(&bands, threads, gatherBands, &space->band);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    for (int n = 0; n < layout.ledCount; n++)
+    {
+        long area = footprint->area[n];
+        led[n].rgbtRed = area ? redSum[n] / area : 0;
+        led[n].rgbtGreen = area ? greenSum[n] / area : 0;
+        led[n].rgbtBlue = area ? blueSum[n] / area : 0;
+    }
+    return 0;
+}
+
+// works out the footprint of every LED on an infile that averages runs of pxColumns x pxRows pixels into
+// each pixel of the scaled image
+void measureFootprint (FOOTPRINT *footprint, long pxColumns, long pxRows)
+{
+    footprint->pxColumns = pxColumns;
+    footprint->pxRows = pxRows;
+    for (int n = 0; n < layout.ledCount; n++)
+    {
+        footprint->area[n] = 0;
+    }
+
+    for (int y = 0; y < layout.height; y++)
+    {
+        const int16_t *index = layout.index + y * layout.width;
+        footprint->spanCount[y] = 0;
+
+        int x = 0;
+        while (x < layout.width)
+        {
+            int ledNumber = index[x];
+            int start = x;
+            while (x < layout.width && index[x] == ledNumber)
+            {
+                x++;
+            }
+            if (ledNumber != -1)
+            {
+                LEDSPAN *span = &footprint->spans[y][footprint->spanCount[y]++];
+                span->led = ledNumber;
+                span->start = start * pxColumns;
+                span->end = x * pxColumns;
+                footprint->area[ledNumber] += (x - start) * pxColumns * pxRows;
+            }
+        }
+    }
+}
+
+// worker that sums bands into its own LED totals until there are none left, then adds them to the shared ones
+void *gatherBands (void *arg)
+{
+    BANDS *bands = ((WORKER *) arg)->bands;
+    const FOOTPRINT *footprint = bands->footprint;
+
+    BYTE *buffer;
+    if (allocateBand(arg, &buffer) != 0)
+    {
+        return NULL;
+    }
+
+    long redSum[LED_MAX_COUNT];
+    long greenSum[LED_MAX_COUNT];
+    long blueSum[LED_MAX_COUNT];
+    memset(redSum, 0, layout.ledCount * sizeof(long));
+    memset(greenSum, 0, layout.ledCount * sizeof(long));
+    memset(blueSum, 0, layout.ledCount * sizeof(long));
+
+    int band;
+    const BYTE *scanlines;
+    while ((scanlines = claimBand(bands, buffer, &band)) != NULL)
+    {
+        // bands run bottom-up while the LED map runs top-down
+        int y = layout.height - 1 - band;
+
+        for (long i = 0; i < bands->pxRows; i++)
+        {
+            const RGBTRIPLE *scanline = (const RGBTRIPLE *) (scanlines + i * bands->lines->step);
+
+            // sum each run straight into its LED
+            for (int s = 0; s < footprint->spanCount[y]; s++)
+            {
+                const LEDSPAN *span = &footprint->spans[y][s];
+                sumPixels((const BYTE *) (scanline + span->start), span->end - span->start,
+                          &blueSum[span->led], &greenSum[span->led], &redSum[span->led]);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&bands->lock);
+    for (int n = 0; n < layout.ledCount; n++)
+    {
+        bands->redSum[n] += redSum[n];
+        bands->greenSum[n] += greenSum[n];
+        bands->blueSum[n] += blueSum[n];
+    }
+    pthread_mutex_unlock(&bands->lock);
+
+    return NULL;
+}
+
+// runs worker on the calling thread (reading into buffer) and threads - 1 more (with buffers of their own),
+// each claiming bands until all layout.height have been handed out, and returns the first error any of them hit
+int runBands (BANDS *bands, int threads, void *(*worker) (void *), BUFFER *buffer)
+{
+    pthread_mutex_init(&bands->lock, NULL);
+    bands->next = 0;
+    bands->status = 0;
+
+    // there is no point in more threads than bands
+    if (threads > layout.height)
+    {
+        threads = layout.height;
+    }
+
+    // if a thread can't be started the remaining ones just pick up its bands
+    pthread_t helpers[SCALED_MAX_HEIGHT];
+    BUFFER helperBuffers[SCALED_MAX_HEIGHT];
+    WORKER workers[SCALED_MAX_HEIGHT];
+    int started = 0;
+    while (started < threads - 1)
+    {
+        helperBuffers[started].data = NULL;
+        helperBuffers[started].size = 0;
+        workers[started].bands = bands;
+        workers[started].buffer = &helperBuffers[started];
+        if (pthread_create(&helpers[started], NULL, worker, &workers[started]) != 0)
+        {
+            break;
+        }
+        started++;
+    }
+
+    WORKER self = {bands, buffer};
+    worker(&self);
+
+    for (int t = 0; t < started; t++)
+    {
+        pthread_join(helpers[t], NULL);
+        free(helperBuffers[t].data);
+    }
+
+    pthread_mutex_destroy(&bands->lock);
+    return bands->status;
+}
+
+// gives a worker somewhere to read and decode its bands into, growing its buffer if needed, none is needed
+// when infile is mapped and needs no decoding
+int allocateBand (WORKER *worker, BYTE **buffer)
+{
+    BANDS *bands = worker->bands;
+
+    *buffer = NULL;
+    if (scanlineBytes(bands->lines) == 0)
+    {
+        return 0;
+    }
+
+    if (growBuffer(worker->buffer, bands->maxRows * scanlineBytes(bands->lines)) != 0)
+    {
+        pthread_mutex_lock(&bands->lock);
+        bands->status = 2;
+        pthread_mutex_unlock(&bands->lock);
+        return 1;
+    }
+    *buffer = worker->buffer->data;
+    return 0;
+}
+
+// makes sure buffer holds at least size bytes, returns 1 if we run out of memory
+int growBuffer (BUFFER *buffer, size_t size)
+{
+    if (buffer->size < size)
+    {
+        BYTE *grown = realloc(buffer->data, size);
+        if (grown == NULL)
+        {
+            return 1;
+        }
+        buffer->data = grown;
+        buffer->size = size;
+    }
+    return 0;
+}
+
+// hands out the next band (numbered bottom-up, same as the scaled image rows) along with its scanlines, in
+// the order they are stored in infile, returns NULL once all bands are taken or something went wrong
+const BYTE *claimBand (BANDS *bands, BYTE *buffer, int *band)
+{
+    const BYTE *scanlines = NULL;
+
+    // scanlines come off infile in order, so reading is done while holding the lock
+    pthread_mutex_lock(&bands->lock);
+    if (bands->status == 0 && bands->next < layout.height)
+    {
+        int next = bands->lines->topDown ? layout.height - 1 - bands->next : bands->next;
+        const COVERAGE *rows = &bands->rows[next];
+        scanlines = nextScanlines(bands->lines, rows->first, rows->last - rows->first + 1, buffer);
+        if (scanlines == NULL)
+        {
+            bands->status = 1;
+        }
+        else
+        {
+            *band = next;
+            bands->next++;
+        }
+    }
+    pthread_mutex_unlock(&bands->lock);
+
+    return scanlines;
+}
+
+// writes the in-memory scaled image to a BMP file with the given headers
+int writeScaled (char *tempfile, BITMAPFILEHEADER *bf, BITMAPINFOHEADER *bi, RGBTRIPLE scaled[][SCALED_MAX_WIDTH])
+{
+    FILE *tempptr = fopen(tempfile, "w");
+    if (tempptr == NULL)
+    {
+        return 1;
+    }
+
+    // write temp file's BITMAPFILEHEADER
+    fwrite(bf, sizeof(BITMAPFILEHEADER), 1, tempptr);
+
+    // write temp file's BITMAPINFOHEADER
+    fwrite(bi, sizeof(BITMAPINFOHEADER), 1, tempptr);
+
+    // determine padding for scanlines
+    int padding = (4 - (bi->biWidth * sizeof(RGBTRIPLE)) % 4) % 4;
+
+    for (int i = 0; i < bi->biHeight; i++)
+    {
+        fwrite(scaled[i], sizeof(RGBTRIPLE), bi->biWidth, tempptr);
+
+        // add output padding
+        for (int j = 0; j < padding; j++)
+        {
+            fputc(0x00, tempptr);
+        }
+    }
+
+    return fclose(tempptr) == 0 ? 0 : 1;
+}
+
+// prepares to read the scanlines of a bi shaped image with pixels stored as in format, file must be
+// positioned at the first scanline, and if it's a regular file the whole of it is mapped (so the image
+// doesn't have to be the first in the file)
+void openScanlines (SCANLINES *lines, FILE *file, BITMAPINFOHEADER *bi, const PIXELFORMAT *format)
+{
+    lines->file = file;
+    lines->map = NULL;
+    lines->mapSize = 0;
+    lines->width = bi->biWidth;
+    lines->height = bi->biHeight < 0 ? -(long) bi->biHeight : bi->biHeight;
+    lines->topDown = bi->biHeight < 0;
+
+    // BMP scanlines are padded to a multiple of 4 bytes, netpbm ones aren't and PNG ones only to a whole byte
+    lines->stride = format->compression == BI_PNG ? (bi->biWidth * (long) format->bitCount + 7) / 8
+                  : format->samples > 0 ? bi->biWidth * (long) format->samples * format->sampleBytes
+                  : (bi->biWidth * (long) format->bitCount + 31) / 32 * 4;
+
+    // 32-bit pixels with the usual byte masks are only packed down (or blended when they have alpha), any
+    // other masks take the slow way
+    lines->format = format;
+    lines->decode = NULL;
+    if (format->samples > 0)
+    {
+        bool bytes = format->samples == 3 && format->maxval == 255;
+        lines->decode = bytes ? swapPixels : unpackSamples;
+    }
+    else if (format->bitCount <= 8 && (format->compression == BI_RGB || format->compression == BI_PNG))
+    {
+        lines->decode = expandIndices;
+    }
+    else if (format->bitCount == 32)
+    {
+        bool bytes = format->masks[0] == 0x000000ff && format->masks[1] == 0x0000ff00 &&
+                     format->masks[2] == 0x00ff0000 && (format->masks[3] == 0 || format->masks[3] == 0xff000000);
+        if (!bytes)
+        {
+            lines->decode = unmaskPixels;
+        }
+        else if (format->blend && format->masks[3] != 0)
+        {
+            lines->decode = blendPixels;
+        }
+        else
+        {
+            lines->decode = packPixels;
+        }
+    }
+    lines->pixelStride = bi->biWidth * sizeof(RGBTRIPLE);
+
+    // runs are only read once the first scanlines are asked for, as many as infile says there are
+    lines->runs = NULL;
+    lines->runsLength = bi->biSizeImage;
+    lines->runsSize = 0;
+    lines->cursor = 0;
+    lines->runsCopy = NULL;
+    lines->blankRows = 0;
+    lines->runX = 0;
+    lines->runsEnded = false;
+    lines->png = NULL;
+    lines->inMemory = false;
+
+    // decoded scanlines are laid out bottom-up, stored ones whichever way infile has them
+    bool runs = format->compression == BI_RLE8 || format->compression == BI_RLE4;
+    lines->step = lines->decode != NULL || runs ? lines->pixelStride : lines->topDown ? -lines->stride : lines->stride;
+    lines->row = 0;
+    lines->last = NULL;
+    lines->bytes = 0;
+    lines->reads = 0;
+
+    // only regular files can be mapped, the scanlines start wherever file is now
+    struct stat st;
+    off_t offset = file != NULL ? ftello(file) : 0;
+    lines->offset = offset;
+    if (file != NULL && offset >= 0 && fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (map != MAP_FAILED)
+        {
+            // scanlines are visited roughly once, front to back
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            lines->map = map;
+            lines->mapSize = st.st_size;
+        }
+    }
+}
+
+// prepares to hand out the scanlines of a bi shaped image of plain 24-bit pixels that is already in memory at
+// pixels, laid out as in a BMP file, the same way as from a mapped file
+void openPixels (SCANLINES *lines, const BYTE *pixels, BITMAPINFOHEADER *bi, const PIXELFORMAT *format)
+{
+    openScanlines(lines, NULL, bi, format);
+    lines->map = (BYTE *) pixels;
+    lines->mapSize = lines->height * lines->stride;
+    lines->inMemory = true;
+}
+
+// returns count scanlines starting from scanline first (counted bottom-up) as one block, either in place in
+// the mapping or read into buffer (which must hold count * scanlineBytes bytes) with a single fread, and
+// decoded into the start of buffer if need be, the returned pointer is to scanline first and the ones above
+// it are step bytes apart, scanlines are handed out in the order they are stored and a block can only go
+// back to the last scanline handed out before, returns NULL if the file ends early or we run out of memory
+const BYTE *nextScanlines (SCANLINES *lines, long first, long count, BYTE *buffer)
+{
+    DWORD compression = lines->format->compression;
+    if (compression == BI_RLE8 || compression == BI_RLE4 || compression == BI_PNG)
+    {
+        return nextDecodedLines(lines, first, count, buffer);
+    }
+
+    // the block as it is stored, which for a top-down file starts at the top of the requested scanlines
+    long stored = lines->topDown ? lines->height - first - count : first;
+    size_t bottom = lines->topDown && count > 0 ? (count - 1) * lines->stride : 0;
+
+    // a stream is read in after the decoded scanlines
+    BYTE *raw = lines->decode != NULL ? buffer + count * lines->pixelStride : buffer;
+
+    const BYTE *block;
+    size_t size = count * lines->stride;
+    if (lines->map != NULL)
+    {
+        size_t start = lines->offset + stored * lines->stride;
+        if (stored < 0 || start > lines->mapSize || lines->mapSize - start < size)
+        {
+            return NULL;
+        }
+        lines->row = stored + count;
+        block = lines->map + start;
+    }
+    else
+    {
+        // a stream can't go back, so a scanline shared with the last band comes from the copy kept of it
+        BYTE *fresh = raw;
+        if (stored < lines->row && count > 0)
+        {
+            memcpy(raw, lines->last, lines->stride);
+            fresh += lines->stride;
+        }
+
+        long freshCount = stored + count - lines->row;
+        if (freshCount > 0)
+        {
+            lines->reads++;
+            if (fread(fresh, freshCount * lines->stride, 1, lines->file) != 1)
+            {
+                return NULL;
+            }
+            lines->row += freshCount;
+
+            // keep the last scanline for a band that starts with it
+            if (lines->last == NULL)
+            {
+                lines->last = malloc(lines->stride);
+                if (lines->last == NULL)
+                {
+                    return NULL;
+                }
+            }
+            memcpy(lines->last, raw + size - lines->stride, lines->stride);
+        }
+        block = raw;
+    }
+    lines->bytes += size;
+
+    if (lines->decode == NULL)
+    {
+        return block + bottom;
+    }
+
+    // decoded bottom-up, so they come out in the same order for both kinds of file
+    long storedStep = lines->topDown ? -lines->stride : lines->stride;
+    for (long i = 0; i < count; i++)
+    {
+        lines->decode(block + bottom + i * storedStep, buffer + i * lines->pixelStride, lines->width, lines->format);
+    }
+    return buffer;
+}
+
+// bytes of buffer that each scanline of a block needs: none when it can be handed out in place in the
+// mapping, the stored scanline when it's read from a stream and the decoded one when it isn't plain BGR
+size_t scanlineBytes (const SCANLINES *lines)
+{
+    DWORD compression = lines->format->compression;
+    if (compression == BI_RLE8 || compression == BI_RLE4 || compression == BI_PNG)
+    {
+        return lines->pixelStride;
+    }
+    return (lines->map == NULL ? lines->stride : 0) + (lines->decode != NULL ? lines->pixelStride : 0);
+}
+
+// nextScanlines for run-length encoded or PNG scanlines, which can only be found by decoding every one
+// stored before them, so they are decoded straight into buffer (bottom-up, like any other decoded block) in
+// the order they are stored and a copy of the last one is kept for a band that starts with it
+const BYTE *nextDecodedLines (SCANLINES *lines, long first, long count, BYTE *buffer)
+{
+    bool png = lines->format->compression == BI_PNG;
+    if (png ? lines->png == NULL && startPng(lines) != 0 : lines->runs == NULL && readRuns(lines) != 0)
+    {
+        return NULL;
+    }
+
+    // the block as it is stored, which for a top-down file starts at the top of the requested scanlines
+    long stored = lines->topDown ? lines->height - first - count : first;
+    size_t start = lines->cursor;
+    for (long i = 0; i < count; i++)
+    {
+        BYTE *pixels = buffer + (lines->topDown ? count - 1 - i : i) * lines->pixelStride;
+        if (stored + i < lines->row)
+        {
+            memcpy(pixels, lines->last, lines->pixelStride);
+        }
+        else if (stored + i > lines->row || lines->row == lines->height ||
+                 (png ? decodePngLine(lines, pixels) : decodeRunLine(lines, pixels)) != 0)
+        {
+            return NULL;
+        }
+        else
+        {
+            lines->row++;
+        }
+    }
+
+    // keep the last scanline for a band that starts with it
+    if (count > 0)
+    {
+        if (lines->last == NULL)
+        {
+            lines->last = malloc(lines->pixelStride);
+            if (lines->last == NULL)
+            {
+                return NULL;
+            }
+        }
+        memcpy(lines->last, buffer + (lines->topDown ? 0 : count - 1) * lines->pixelStride, lines->pixelStride);
+    }
+
+    // PNG bytes are counted as they are inflated
+    if (!png)
+    {
+        lines->bytes += lines->cursor - start;
+    }
+    return buffer;
+}
+
+// finds the runs of a run-length encoded infile: as many bytes as its header says (or the rest of the file
+// when it doesn't) of the mapping, or of a stream read into memory, returns 1 if we run out of memory or
+// the stream ends early
+int readRuns (SCANLINES *lines)
+{
+    if (lines->map != NULL)
+    {
+        if (lines->offset > lines->mapSize)
+        {
+            return 1;
+        }
+        lines->runs = lines->map + lines->offset;
+        lines->runsSize = lines->mapSize - lines->offset;
+        if (lines->runsLength > 0 && lines->runsLength < lines->runsSize)
+        {
+            lines->runsSize = lines->runsLength;
+        }
+        return 0;
+    }
+
+    // a stream can hold more images after this one, so only what belongs to it is read
+    if (lines->runsLength > 0)
+    {
+        lines->runsCopy = malloc(lines->runsLength);
+        lines->reads++;
+        if (lines->runsCopy == NULL || fread(lines->runsCopy, lines->runsLength, 1, lines->file) != 1)
+        {
+            return 1;
+        }
+        lines->runs = lines->runsCopy;
+        lines->runsSize = lines->runsLength;
+        return 0;
+    }
+
+    size_t capacity = 0;
+    size_t got;
+    do
+    {
+        if (lines->runsSize == capacity)
+        {
+            capacity = capacity == 0 ? 65536 : 2 * capacity;
+            BYTE *grown = realloc(lines->runsCopy, capacity);
+            if (grown == NULL)
+            {
+                return 1;
+            }
+            lines->runsCopy = grown;
+        }
+        lines->reads++;
+        got = fread(lines->runsCopy + lines->runsSize, 1, capacity - lines->runsSize, lines->file);
+        lines->runsSize += got;
+    }
+    while (got > 0);
+
+    lines->runs = lines->runsCopy;
+    return 0;
+}
+
+// decodes the next run-length encoded scanline into pixels, pixels that no run covers (skipped by a jump or
+// left once the runs end) are colour 0 of the palette, returns 1 if the runs end in the middle of a code
+int decodeRunLine (SCANLINES *lines, BYTE *pixels)
+{
+    const PIXELFORMAT *format = lines->format;
+    const BYTE *runs = lines->runs;
+    long width = lines->width;
+    bool nibbles = format->compression == BI_RLE4;
+
+    fillPixels(pixels, format->palette[0], width);
+    if (lines->runsEnded)
+    {
+        return 0;
+    }
+    if (lines->blankRows > 0)
+    {
+        lines->blankRows--;
+        return 0;
+    }
+
+    long x = lines->runX;
+    lines->runX = 0;
+    while (true)
+    {
+        if (lines->runsSize - lines->cursor < 2)
+        {
+            return 1;
+        }
+        int count = runs[lines->cursor];
+        int value = runs[lines->cursor + 1];
+        lines->cursor += 2;
+
+        if (count > 0)
+        {
+            // a run of count pixels of one index (or, with nibbles, two alternating ones)
+            long n = width - x < count ? (width - x > 0 ? width - x : 0) : count;
+            if (!nibbles || value >> 4 == (value & 0x0f))
+            {
+                fillPixels(pixels + 3 * x, format->palette[nibbles ? value >> 4 : value], n);
+            }
+            else
+            {
+                for (long j = 0; j < n; j++)
+                {
+                    memcpy(pixels + 3 * (x + j), format->palette[j % 2 == 0 ? value >> 4 : value & 0x0f], 3);
+                }
+            }
+            x += count;
+        }
+        else if (value == 0)
+        {
+            // end of the scanline
+            return 0;
+        }
+        else if (value == 1)
+        {
+            // end of the image, every scanline left is blank
+            lines->runsEnded = true;
+            return 0;
+        }
+        else if (value == 2)
+        {
+            // jump right and up, rows jumped over are blank
+            if (lines->runsSize - lines->cursor < 2)
+            {
+                return 1;
+            }
+            x += runs[lines->cursor];
+            long up = runs[lines->cursor + 1];
+            lines->cursor += 2;
+            if (up > 0)
+            {
+                lines->blankRows = up - 1;
+                lines->runX = x;
+                return 0;
+            }
+        }
+        else
+        {
+            // value indices as they are, padded to a whole number of 16-bit words
+            size_t bytes = nibbles ? (value + 1) / 2 : value;
+            bytes += bytes % 2;
+            if (lines->runsSize - lines->cursor < bytes)
+            {
+                return 1;
+            }
+            const BYTE *indices = runs + lines->cursor;
+            for (long j = 0; j < value && x + j < width; j++)
+            {
+                int index = !nibbles ? indices[j] : j % 2 == 0 ? indices[j / 2] >> 4 : indices[j / 2] & 0x0f;
+                memcpy(pixels + 3 * (x + j), format->palette[index], 3);
+            }
+            x += value;
+            lines->cursor += bytes;
+        }
+    }
+}
+
+// sets count pixels to one colour, doubling what's been set so far with each copy
+void fillPixels (BYTE *pixels, const BYTE *colour, long count)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+    memcpy(pixels, colour, 3);
+    for (long done = 1; done < count; done *= 2)
+    {
+        memcpy(pixels + 3 * done, pixels, 3 * (done < count - done ? done : count - done));
+    }
+}
+
+// sets up inflating the IDAT chunks of a PNG, returns 1 if we run out of memory
+int startPng (SCANLINES *lines)
+{
+    lines->png = malloc(sizeof(PNGSTREAM));
+    BYTE *rows = calloc(2, lines->stride + 1);
+    if (lines->png == NULL || rows == NULL)
+    {
+        free(rows);
+        return 1;
+    }
+
+    PNGSTREAM *png = lines->png;
+    png->chunkLeft = lines->format->chunkLength;
+    png->chunksEnded = false;
+    png->previous = rows;
+    png->current = rows + lines->stride + 1;
+    startInflate(&png->inflate, fillPng, lines);
+    return 0;
+}
+
+// hands the inflate the next piece of the IDAT chunks of the PNG whose SCANLINES are source, in place in
+// the mapping or read from a stream, returns false once they run out
+bool fillPng (void *source, const BYTE **next, size_t *available)
+{
+    SCANLINES *lines = source;
+    PNGSTREAM *png = lines->png;
+    while (png->chunkLeft == 0)
+    {
+        if (png->chunksEnded || nextChunk(lines) != 0)
+        {
+            return false;
+        }
+    }
+
+    size_t size = png->chunkLeft;
+    if (lines->map != NULL)
+    {
+        size_t left = lines->mapSize - lines->offset - lines->cursor;
+        size = size < left ? size : left;
+        *next = lines->map + lines->offset + lines->cursor;
+    }
+    else
+    {
+        size = size < sizeof(png->input) ? size : sizeof(png->input);
+        lines->reads++;
+        size = fread(png->input, 1, size, lines->file);
+        *next = png->input;
+    }
+    lines->cursor += size;
+    lines->bytes += size;
+    png->chunkLeft -= size;
+    *available = size;
+    return size > 0;
+}
+
+// reads the next count bytes of the file past what's been used up into bytes, or skips them when bytes is
+// NULL, returns 1 if the file ends first
+int readStored (SCANLINES *lines, BYTE *bytes, size_t count)
+{
+    if (lines->map != NULL)
+    {
+        if (lines->mapSize - lines->offset - lines->cursor < count)
+        {
+            return 1;
+        }
+        if (bytes != NULL)
+        {
+            memcpy(bytes, lines->map + lines->offset + lines->cursor, count);
+        }
+    }
+    else
+    {
+        lines->reads++;
+        if (bytes != NULL ? fread(bytes, count, 1, lines->file) != 1 : skipBytes(lines->file, count) != 0)
+        {
+            return 1;
+        }
+    }
+    lines->cursor += count;
+    return 0;
+}
+
+// moves on from the end of a PNG chunk (its CRC) to the next one: the next IDAT chunk, or the first chunk
+// after them, whose header is kept, returns 1 if the file ends first
+int nextChunk (SCANLINES *lines)
+{
+    PNGSTREAM *png = lines->png;
+    if (readStored(lines, NULL, 4) != 0 || readStored(lines, png->next, sizeof(png->next)) != 0)
+    {
+        return 1;
+    }
+    if (memcmp(png->next + 4, "IDAT", 4) == 0)
+    {
+        png->chunkLeft = bigEndian(png->next);
+    }
+    else
+    {
+        png->chunksEnded = true;
+    }
+    return 0;
+}
+
+// inflates and unfilters the next PNG scanline and decodes it into pixels, returns 1 if it's broken or the
+// file ends first
+int decodePngLine (SCANLINES *lines, BYTE *pixels)
+{
+    PNGSTREAM *png = lines->png;
+    if (inflateBytes(&png->inflate, png->current, lines->stride + 1) != 0 ||
+        unfilterScanline(png->current + 1, png->previous + 1, lines->stride, (lines->format->bitCount + 7) / 8,
+                         png->current[0]) != 0)
+    {
+        return 1;
+    }
+    lines->decode(png->current + 1, pixels, lines->width, lines->format);
+
+    BYTE *previous = png->previous;
+    png->previous = png->current;
+    png->current = previous;
+    return 0;
+}
+
+// undoes the filter a PNG scanline of size bytes was stored with, each byte predicted from the one
+// pixelBytes before it (left), the one above it in prior (up) or both, returns 1 if there's no such filter
+int unfilterScanline (BYTE *row, const BYTE *prior, long size, int pixelBytes, int filter)
+{
+    if (filter == 1)
+    {
+        for (long i = pixelBytes; i < size; i++)
+        {
+            row[i] += row[i - pixelBytes];
+        }
+    }
+    else if (filter == 2)
+    {
+        for (long i = 0; i < size; i++)
+        {
+            row[i] += prior[i];
+        }
+    }
+    else if (filter == 3)
+    {
+        for (long i = 0; i < size; i++)
+        {
+            int left = i < pixelBytes ? 0 : row[i - pixelBytes];
+            row[i] += (left + prior[i]) / 2;
+        }
+    }
+    else if (filter == 4)
+    {
+        // Paeth: whichever of left, up and up-left is closest to left + up - up-left
+        for (long i = 0; i < size; i++)
+        {
+            int left = i < pixelBytes ? 0 : row[i - pixelBytes];
+            int up = prior[i];
+            int upLeft = i < pixelBytes ? 0 : prior[i - pixelBytes];
+            int toLeft = abs(up - upLeft);
+            int toUp = abs(left - upLeft);
+            int toUpLeft = abs(left + up - 2 * upLeft);
+            row[i] += toLeft <= toUp && toLeft <= toUpLeft ? left : toUp <= toUpLeft ? up : upLeft;
+        }
+    }
+    else if (filter != 0)
+    {
+        return 1;
+    }
+    return 0;
+}
+
+// skips what's left of a PNG's IDAT chunks and every chunk after them, up to the end of IEND, so the file
+// is left where the next image in it starts
+void finishPng (SCANLINES *lines)
+{
+    PNGSTREAM *png = lines->png;
+    while (!png->chunksEnded)
+    {
+        if (readStored(lines, NULL, png->chunkLeft) != 0 || nextChunk(lines) != 0)
+        {
+            return;
+        }
+        png->chunkLeft = png->chunksEnded ? 0 : png->chunkLeft;
+    }
+
+    while (memcmp(png->next + 4, "IEND", 4) != 0)
+    {
+        if (readStored(lines, NULL, bigEndian(png->next)) != 0 || readStored(lines, NULL, 4) != 0 ||
+            readStored(lines, png->next, sizeof(png->next)) != 0)
+        {
+            return;
+        }
+    }
+    readStored(lines, NULL, bigEndian(png->next) + 4);
+}
+
+// unmaps the file (leaving it positioned after the image) or frees the copy of the last scanline
+void closeScanlines (SCANLINES *lines)
+{
+    // a stream skips any scanlines that weren't asked for, so the next image in it starts where it should
+    bool runs = lines->format->compression == BI_RLE8 || lines->format->compression == BI_RLE4;
+    bool png = lines->format->compression == BI_PNG;
+    if (png && lines->png != NULL)
+    {
+        finishPng(lines);
+        free(lines->png->previous < lines->png->current ? lines->png->previous : lines->png->current);
+        free(lines->png);
+        lines->png = NULL;
+    }
+    if (lines->map == NULL && !runs && !png && lines->last != NULL)
+    {
+        while (lines->row < lines->height && fread(lines->last, lines->stride, 1, lines->file) == 1)
+        {
+            lines->row++;
+        }
+    }
+
+    free(lines->last);
+    lines->last = NULL;
+    free(lines->runsCopy);
+    lines->runsCopy = NULL;
+
+    if (lines->map != NULL && !lines->inMemory)
+    {
+        // leave file after the image, the same as a stream would be, for any images after it
+        size_t size = png ? lines->cursor : !runs ? (size_t) (lines->height * lines->stride) :
+                      lines->runsLength > 0 ? lines->runsLength : lines->cursor;
+        fseeko(lines->file, lines->offset + size, SEEK_SET);
+        munmap(lines->map, lines->mapSize);
+        lines->map = NULL;
+    }
+}
+
+// adds part's times and counts onto total, which can be shared between threads, nothing happens if total is NULL
+void addStats (STATS *total, STATS *part)
+{
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+    if (total == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    total->images += part->images;
+    total->open += part->open;
+    total->header += part->header;
+    total->downscale += part->downscale;
+    total->temp += part->temp;
+    total->aggregate += part->aggregate;
+    total->output += part->output;
+    total->bytesRead += part->bytesRead;
+    total->bytesWritten += part->bytesWritten;
+    total->readCalls += part->readCalls;
+    pthread_mutex_unlock(&lock);
+}
+
+// prints stats as one line of JSON on stderr, along with how many seconds the whole run took
+void printStats (STATS *stats, double seconds)
+{
+    fprintf(stderr, "{\"images\": %li, \"seconds\": %.6f, \"open\": %.6f, \"header\": %.6f, \"downscale\": %.6f, "
+            "\"temp\": %.6f, \"aggregate\": %.6f, \"output\": %.6f, \"bytes_read\": %zu, \"bytes_written\": %zu, "
+            "\"read_calls\": %li}\n",
+            stats->images, seconds, stats->open, stats->header, stats->downscale, stats->temp, stats->aggregate,
+            stats->output, stats->bytesRead, stats->bytesWritten, stats->readCalls);
+}
+
+// seconds on a clock that only goes forward
+double now (void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// seconds since *mark, which moves up to now
+double lap (double *mark)
+{
+    double then = *mark;
+    *mark = now();
+    return *mark - then;
+}
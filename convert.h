@@ -0,0 +1,360 @@
+// *******************************************************************************************************
+// The stages of converting an image (a BMP file of 1, 4 or 8-bit palette indices, run-length encoded or not,
+// or of 24-bit or 32-bit colours, a PNG, PPM, PGM or PAM file, raw RGB, or the frames of an animated GIF)
+// into LED values for a HERA display, or any other with a layout file (reading scanlines, scaling, aggregating
+// LEDs and writing frames), shared by ledcsv and benchcsv.
+// *******************************************************************************************************
+
+#ifndef CONVERT_H
+#define CONVERT_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bmp.h"
+#include "inflate.h"
+#include "ledmap.h"
+
+// resampling kernels picked with -k: the exact area average, and filters that reach past the pixels
+// of the scaled image to smooth out aliasing
+#define KERNEL_AREA 0
+#define KERNEL_BILINEAR 1
+#define KERNEL_LANCZOS 2
+#define KERNEL_GAUSSIAN 3
+
+// most bytes of headers (the info header, bit masks and any gap) that can come before infile's pixels
+#define HEADERS_MAX 16384
+
+// longest a frame of csv lines can get: a leading newline, then "nnnn, rrr, ggg, bbb\n" for every LED
+#define CSV_FRAME_SIZE (1 + LED_MAX_COUNT * 20)
+
+// how infile stores its pixels, worked out from its headers: 24-bit pixels are plain BGR, 1, 4 and 8-bit ones
+// are indices into palette (every byte of which expand looks up as all the pixels it holds, most significant
+// first) that may be run-length encoded, while in 32-bit ones blue, green, red and alpha each sit under a
+// mask shift bits up and bits wide (0 bits for no alpha), netpbm (and raw) pixels are samples of
+// sampleBytes each (big-endian) up to maxval: grey, grey and alpha, RGB or RGB and alpha, alpha is only
+// blended into background when blend is set and is ignored otherwise, headerSize counts the bytes before
+// the pixels, a PNG (compression BI_PNG) is stored as either palette indices or samples, and its first IDAT
+// chunk has chunkLength bytes in it after its headers
+typedef struct
+{
+    int bitCount;
+    DWORD compression;
+    int samples;
+    int sampleBytes;
+    DWORD maxval;
+    size_t headerSize;
+    DWORD chunkLength;
+    BYTE palette[256][3];
+    BYTE expand[256][8 * 3];
+    DWORD masks[4];
+    int shifts[4];
+    int bits[4];
+    bool blend;
+    RGBTRIPLE background;
+}
+PIXELFORMAT;
+
+// the IDAT chunks of a PNG inflated one scanline at a time: chunkLeft bytes of the current chunk are still to
+// come (from the mapping, or read from a stream into input), and once they run out the header of the chunk
+// after them is kept in next, every scanline (a filter type byte, then the stored scanline) is inflated into
+// current and unfiltered against previous, the one stored before it, which starts out as zeroes
+typedef struct
+{
+    INFLATE inflate;
+    size_t chunkLeft;
+    bool chunksEnded;
+    BYTE next[8];
+    BYTE input[65536];
+    BYTE *previous;
+    BYTE *current;
+}
+PNGSTREAM;
+
+// whole (padded, for a BMP) scanlines of an image, either walked in place in a memory mapping of the file or
+// read from a stream into the caller's buffer when the file can't be mapped (pipes, stdin), counting
+// the bytes handed out and the reads it took, a stream keeps a copy of the last scanline it read
+// (row - 1) for bands that share it, scanlines are always numbered bottom-up so the height rows of a
+// top-down file are handed out last one first and step (the distance from one scanline to the one above
+// it) is negative, scanlines that aren't plain 24-bit BGR are decoded into it (pixelStride bytes each) on
+// the way out, run-length encoded ones from runs (runsLength bytes of them, or the rest of the file when
+// that's 0, read in whole from a stream) one after the other, where a jump can leave blankRows rows to go
+// before the next one carries on from column runX, and PNG ones through png in the order they are stored,
+// with cursor counting the bytes of the file used up past offset, an image already in memory is handed out
+// from map the same as a mapped file
+typedef struct
+{
+    FILE *file;
+    BYTE *map;
+    size_t mapSize;
+    size_t offset;
+    long width;
+    long stride;
+    long height;
+    bool topDown;
+    const PIXELFORMAT *format;
+    void (*decode) (const BYTE *stored, BYTE *pixels, long width, const PIXELFORMAT *format);
+    long pixelStride;
+    const BYTE *runs;
+    size_t runsLength;
+    size_t runsSize;
+    size_t cursor;
+    BYTE *runsCopy;
+    long blankRows;
+    long runX;
+    bool runsEnded;
+    PNGSTREAM *png;
+    bool inMemory;
+    long step;
+    long row;
+    BYTE *last;
+    size_t bytes;
+    long reads;
+}
+SCANLINES;
+
+// an animated GIF decoded a frame at a time onto canvas (width x height plain 24-bit pixels stored top-down
+// like a BMP, with rows stride bytes apart) from the whole file held in data (mapped, or read in from a
+// stream), with the delay of every frame (in hundredths of a second) found up front, position is where the
+// blocks of the next frame start, and the last frame drawn stays on canvas until the next one disposes of
+// its left, top, frameWidth x frameHeight rectangle by disposal (restoring saved, the canvas from before it,
+// for 3), colours without a palette entry are black and transparent ones show background, a frame's indices
+// (indicesSize bytes of room) are decoded with the string table of LZW codes: for each the code before it,
+// its last and first index and its length
+typedef struct
+{
+    BYTE *data;
+    size_t size;
+    bool mapped;
+    long width;
+    long height;
+    long stride;
+    BYTE palette[256][3];
+    int colours;
+    RGBTRIPLE background;
+    int frameCount;
+    int *delays;
+    int frame;
+    size_t position;
+    BYTE *canvas;
+    BYTE *saved;
+    BYTE *indices;
+    size_t indicesSize;
+    short prefix[4096];
+    BYTE suffix[4096];
+    BYTE first[4096];
+    short length[4096];
+    int disposal;
+    long left;
+    long top;
+    long frameWidth;
+    long frameHeight;
+}
+ANIMATION;
+
+// a run of infile columns within one row of the scaled image that all belong to one LED
+typedef struct
+{
+    int led;
+    long start;
+    long end;
+}
+LEDSPAN;
+
+// footprint of every LED on an infile of a given geometry: for each row of the scaled image the runs of
+// infile columns that belong to one LED, and how many infile pixels each LED covers in total
+typedef struct
+{
+    long pxColumns;
+    long pxRows;
+    LEDSPAN spans[SCALED_MAX_HEIGHT][SCALED_MAX_WIDTH];
+    int spanCount[SCALED_MAX_HEIGHT];
+    long area[LED_MAX_COUNT];
+}
+FOOTPRINT;
+
+// the infile pixels that make up one pixel of the scaled image along one axis, in units of 1/layout.width
+// (columns) or 1/layout.height (rows) of an infile pixel: first and last are partly covered, by lead and
+// trail units, every pixel in between is covered whole, and when first == last it's covered by lead units
+typedef struct
+{
+    long first;
+    long last;
+    long lead;
+    long trail;
+}
+COVERAGE;
+
+// how an infile of a given geometry is resampled onto the scaled image, the coverage of every column and row
+// of the scaled image and the most infile rows any one of them takes, when both sides divide evenly every
+// infile pixel is covered whole and plain box averaging gives the same result faster
+typedef struct
+{
+    long width;
+    long height;
+    COVERAGE columns[SCALED_MAX_WIDTH];
+    COVERAGE rows[SCALED_MAX_HEIGHT];
+    long maxRows;
+    bool exact;
+}
+RESAMPLE;
+
+// one filter along one axis of the scaled image: pixel x weighs count[x] infile pixels from first[x] on
+// by the weights starting at weights + x * taps, which add up to 1
+typedef struct
+{
+    long first[SCALED_MAX_WIDTH];
+    int count[SCALED_MAX_WIDTH];
+    int taps;
+    float *weights;
+}
+FILTERBANK;
+
+// the filter banks of a kernel for an infile of a given geometry, worked out once per geometry and kernel,
+// and the split of infile into bands of scanlines for the horizontal pass (only first and last are used)
+typedef struct
+{
+    int kernel;
+    long width;
+    long height;
+    FILTERBANK columns;
+    FILTERBANK rows;
+    COVERAGE bands[SCALED_MAX_HEIGHT];
+    long maxRows;
+}
+FILTERS;
+
+// blue, green and red sums of infile pixels under each column of the scaled image, split into the pixels
+// covered whole and the ones at either end that still need weighting
+typedef struct
+{
+    long inner[3][SCALED_MAX_WIDTH];
+    long lead[3][SCALED_MAX_WIDTH];
+    long trail[3][SCALED_MAX_WIDTH];
+}
+COLUMNSUMS;
+
+// memory that grows as needed and is kept for reuse
+typedef struct
+{
+    BYTE *data;
+    size_t size;
+}
+BUFFER;
+
+// memory a converting thread keeps from one image to the next: the buffer it reads streamed bands into,
+// the resampling of the last geometry it read, the filters and horizontally filtered scanlines of the last
+// geometry it filtered and the LED footprint of the last geometry it gathered
+typedef struct
+{
+    BUFFER band;
+    RESAMPLE resample;
+    FILTERS filters;
+    BUFFER filtered;
+    FOOTPRINT footprint;
+}
+WORKSPACE;
+
+// work shared by the threads of a downscale, filter or gather: infile is split into layout.height bands of
+// scanlines (from rows, each at most maxRows long) that are handed out one at a time, a band only ever
+// touches its own row of the scaled image (or its own filtered scanlines) while gather workers keep their
+// own LED totals and add them to the shared ones when they finish, pxColumns x pxRows runs are only used
+// when the geometry is exact
+typedef struct
+{
+    SCANLINES *lines;
+    pthread_mutex_t lock;
+    long pxColumns;
+    long pxRows;
+    const COVERAGE *rows;
+    long maxRows;
+    const RESAMPLE *resample;
+    const FILTERS *filters;
+    float *filtered;
+    int next;
+    int status;
+    RGBTRIPLE (*scaled)[SCALED_MAX_WIDTH];
+    const FOOTPRINT *footprint;
+    long *redSum;
+    long *greenSum;
+    long *blueSum;
+}
+BANDS;
+
+// what each band worker thread gets: the shared bands and a buffer of its own to read them into
+typedef struct
+{
+    BANDS *bands;
+    BUFFER *buffer;
+}
+WORKER;
+
+// seconds spent in each stage of converting images and what went through them, added up over every image
+// (so with several threads the stages can add up to more than the time the run took), downscale also
+// covers gathering in fused mode
+typedef struct
+{
+    long images;
+    double open;
+    double header;
+    double downscale;
+    double temp;
+    double aggregate;
+    double output;
+    size_t bytesRead;
+    size_t bytesWritten;
+    long readCalls;
+}
+STATS;
+
+// how every image is converted, stats is NULL unless they are being collected
+typedef struct
+{
+    bool writeTemp;
+    bool fused;
+    int threads;
+    bool binary;
+    int fps;
+    int kernel;
+    long rawWidth;
+    long rawHeight;
+    bool blend;
+    RGBTRIPLE background;
+    STATS *stats;
+}
+OPTIONS;
+
+size_t startOutput (FILE *outptr, int frameCount, OPTIONS *options);
+void finishOutput (FILE *outptr, int frameCount, OPTIONS *options);
+size_t writeFrame (FILE *outptr, RGBTRIPLE *led, int frame, OPTIONS *options);
+size_t writeBinary (FILE *outptr, RGBTRIPLE *led);
+size_t writeCSV (FILE *outptr, RGBTRIPLE *led, int frame);
+int readHeaders (FILE *inptr, BITMAPINFOHEADER *bi, PIXELFORMAT *format);
+void rawHeaders (BITMAPINFOHEADER *bi, PIXELFORMAT *format, long width, long height);
+int convertImage (char *infile, RGBTRIPLE *led, OPTIONS *options, WORKSPACE *space);
+int convertInput (FILE *inptr, char *infile, RGBTRIPLE *led, OPTIONS *options, WORKSPACE *space, double opening);
+bool isAnimation (FILE *inptr, OPTIONS *options);
+int openAnimation (ANIMATION *gif, FILE *inptr, char *infile, OPTIONS *options);
+int nextAnimationFrame (ANIMATION *gif);
+int convertCanvas (ANIMATION *gif, char *infile, RGBTRIPLE *led, OPTIONS *options, WORKSPACE *space);
+void closeAnimation (ANIMATION *gif);
+void openScanlines (SCANLINES *lines, FILE *file, BITMAPINFOHEADER *bi, const PIXELFORMAT *format);
+void openPixels (SCANLINES *lines, const BYTE *pixels, BITMAPINFOHEADER *bi, const PIXELFORMAT *format);
+size_t scanlineBytes (const SCANLINES *lines);
+const BYTE *nextScanlines (SCANLINES *lines, long first, long count, BYTE *buffer);
+void closeScanlines (SCANLINES *lines);
+void selectKernels (void);
+int downscale (SCANLINES *lines, BITMAPINFOHEADER *bi, RGBTRIPLE scaled[][SCALED_MAX_WIDTH], int kernel,
+               int threads, WORKSPACE *space);
+int findKernel (const char *name);
+void freeWorkspace (WORKSPACE *space);
+void aggregateLEDs (RGBTRIPLE scaled[][SCALED_MAX_WIDTH], RGBTRIPLE *led);
+int gatherLEDs (SCANLINES *lines, BITMAPINFOHEADER *bi, RGBTRIPLE *led, int threads, WORKSPACE *space);
+int writeScaled (char *tempfile, BITMAPFILEHEADER *bf, BITMAPINFOHEADER *bi, RGBTRIPLE scaled[][SCALED_MAX_WIDTH]);
+void addStats (STATS *total, STATS *part);
+void printStats (STATS *stats, double seconds);
+double now (void);
+double lap (double *mark);
+
+#endif
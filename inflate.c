@@ -0,0 +1,428 @@
+// *******************************************************************************************************
+// Inflates a zlib stream a piece at a time: every call picks up where the last one stopped, in the middle of
+// a block or a match if need be, and pulls compressed bytes from the source only as it needs them.
+// *******************************************************************************************************
+
+#include <string.h>
+
+#include "inflate.h"
+
+// what an inflate is reading next: the zlib header, the header of a block, the bytes of a stored block or
+// the codes of a compressed one, or nothing once the last block is done
+#define INFLATE_HEADER 0
+#define INFLATE_BLOCK 1
+#define INFLATE_STORED 2
+#define INFLATE_CODES 3
+#define INFLATE_DONE 4
+
+bool needBits (INFLATE *z, int count);
+int takeBits (INFLATE *z, int count);
+int decodeSymbol (INFLATE *z, const HUFFMAN *h);
+int buildHuffman (HUFFMAN *h, const uint8_t *lengths, int count);
+int readBlockHeader (INFLATE *z);
+int readDynamicCodes (INFLATE *z);
+
+// the first length and the extra bits that follow each length symbol from 257 on, and the same for each
+// distance symbol
+static const short lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+                                     67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4,
+                                     5, 5, 5, 5, 0};
+static const short distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                       513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10,
+                                       10, 11, 11, 12, 12, 13, 13};
+
+// the order code length code lengths are stored in
+static const uint8_t lengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// gets z ready to inflate a zlib stream from the start, pulling compressed bytes from source with fill
+void startInflate (INFLATE *z, bool (*fill) (void *source, const uint8_t **next, size_t *available), void *source)
+{
+    z->fill = fill;
+    z->source = source;
+    z->next = NULL;
+    z->available = 0;
+    z->bits = 0;
+    z->bitCount = 0;
+    z->state = INFLATE_HEADER;
+    z->last = false;
+    z->stored = 0;
+    z->length = 0;
+    z->distance = 0;
+    z->position = 0;
+}
+
+// inflates the next count bytes of the stream into out, returns 1 if the stream is broken or ends (or its
+// source runs out) before then
+int inflateBytes (INFLATE *z, uint8_t *out, size_t count)
+{
+    size_t done = 0;
+    while (done < count)
+    {
+        if (z->state == INFLATE_CODES)
+        {
+            // finish any match the last call stopped in the middle of
+            while (z->length > 0 && done < count)
+            {
+                uint8_t byte = z->window[(z->position - z->distance) & (INFLATE_WINDOW - 1)];
+                out[done++] = byte;
+                z->window[z->position++ & (INFLATE_WINDOW - 1)] = byte;
+                z->length--;
+            }
+            if (done == count)
+            {
+                break;
+            }
+
+            int symbol = decodeSymbol(z, &z->literals);
+            if (symbol < 0)
+            {
+                return 1;
+            }
+            if (symbol < 256)
+            {
+                out[done++] = symbol;
+                z->window[z->position++ & (INFLATE_WINDOW - 1)] = symbol;
+                continue;
+            }
+            if (symbol == 256)
+            {
+                z->state = INFLATE_BLOCK;
+                continue;
+            }
+
+            // a match of length bytes starting distance bytes back, which can't reach past the start
+            symbol -= 257;
+            if (symbol >= 29)
+            {
+                return 1;
+            }
+            int extra = takeBits(z, lengthExtra[symbol]);
+            int code = decodeSymbol(z, &z->distances);
+            if (extra < 0 || code < 0 || code >= 30)
+            {
+                return 1;
+            }
+            int distanceBits = takeBits(z, distanceExtra[code]);
+            if (distanceBits < 0)
+            {
+                return 1;
+            }
+            z->length = lengthBase[symbol] + extra;
+            z->distance = distanceBase[code] + distanceBits;
+            if ((size_t) z->distance > z->position)
+            {
+                return 1;
+            }
+        }
+        else if (z->state == INFLATE_STORED)
+        {
+            if (z->stored == 0)
+            {
+                z->state = INFLATE_BLOCK;
+                continue;
+            }
+
+            // whole bytes left in the bit buffer come first, then straight from the source
+            if (z->bitCount >= 8)
+            {
+                uint8_t byte = z->bits & 0xff;
+                z->bits >>= 8;
+                z->bitCount -= 8;
+                out[done++] = byte;
+                z->window[z->position++ & (INFLATE_WINDOW - 1)] = byte;
+                z->stored--;
+                continue;
+            }
+            if (z->available == 0 && (!z->fill(z->source, &z->next, &z->available) || z->available == 0))
+            {
+                return 1;
+            }
+            size_t size = z->stored;
+            size = size < count - done ? size : count - done;
+            size = size < z->available ? size : z->available;
+            memcpy(out + done, z->next, size);
+            for (size_t i = 0; i < size; i++)
+            {
+                z->window[z->position++ & (INFLATE_WINDOW - 1)] = z->next[i];
+            }
+            z->next += size;
+            z->available -= size;
+            z->stored -= size;
+            done += size;
+        }
+        else if (z->state == INFLATE_BLOCK)
+        {
+            if (z->last)
+            {
+                z->state = INFLATE_DONE;
+            }
+            else if (readBlockHeader(z) != 0)
+            {
+                return 1;
+            }
+        }
+        else if (z->state == INFLATE_HEADER)
+        {
+            // deflate with a window of up to 32K and no preset dictionary
+            int cmf = takeBits(z, 8);
+            int flg = takeBits(z, 8);
+            if (cmf < 0 || flg < 0 || (cmf & 0x0f) != 8 || cmf >> 4 > 7 || (cmf * 256 + flg) % 31 != 0 ||
+                (flg & 0x20) != 0)
+            {
+                return 1;
+            }
+            z->state = INFLATE_BLOCK;
+        }
+        else
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// makes sure there are at least count bits in the bit buffer, returns false if the source runs out first
+bool needBits (INFLATE *z, int count)
+{
+    while (z->bitCount < count)
+    {
+        if (z->available == 0 && (!z->fill(z->source, &z->next, &z->available) || z->available == 0))
+        {
+            return false;
+        }
+        z->bits |= (uint64_t) *z->next++ << z->bitCount;
+        z->available--;
+        z->bitCount += 8;
+    }
+    return true;
+}
+
+// takes the next count bits (least significant first), returns -1 if the source runs out first
+int takeBits (INFLATE *z, int count)
+{
+    if (!needBits(z, count))
+    {
+        return -1;
+    }
+    int value = z->bits & ((1u << count) - 1);
+    z->bits >>= count;
+    z->bitCount -= count;
+    return value;
+}
+
+// decodes the next symbol of code h, looking short codes up in one go and walking longer ones a bit at a
+// time, returns -1 if the source runs out or the bits aren't a code
+int decodeSymbol (INFLATE *z, const HUFFMAN *h)
+{
+    // near the end of the stream there may be fewer bits left than the longest code
+    needBits(z, HUFFMAN_BITS);
+    uint16_t entry = h->fast[z->bits & ((1 << HUFFMAN_FAST_BITS) - 1)];
+    if (entry != 0 && (entry & 15) <= z->bitCount)
+    {
+        z->bits >>= entry & 15;
+        z->bitCount -= entry & 15;
+        return entry >> 4;
+    }
+
+    // codes are stored most significant bit first, so they're built up a bit at a time
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (int length = 1; length <= HUFFMAN_BITS; length++)
+    {
+        int bit = takeBits(z, 1);
+        if (bit < 0)
+        {
+            return -1;
+        }
+        code |= bit;
+        int count = h->count[length];
+        if (code - count < first)
+        {
+            return h->symbol[index + code - first];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+// builds the canonical code that gives each of count symbols the code length in lengths (0 for none),
+// returns 1 if there are more codes of some length than can fit
+int buildHuffman (HUFFMAN *h, const uint8_t *lengths, int count)
+{
+    memset(h->count, 0, sizeof(h->count));
+    for (int s = 0; s < count; s++)
+    {
+        h->count[lengths[s]]++;
+    }
+    h->count[0] = 0;
+
+    // an incomplete code is fine (a block may only use one distance), an over-subscribed one isn't
+    int left = 1;
+    for (int length = 1; length <= HUFFMAN_BITS; length++)
+    {
+        left = (left << 1) - h->count[length];
+        if (left < 0)
+        {
+            return 1;
+        }
+    }
+
+    // symbols in code order: by length, then by symbol
+    short offsets[HUFFMAN_BITS + 2];
+    offsets[1] = 0;
+    for (int length = 1; length <= HUFFMAN_BITS; length++)
+    {
+        offsets[length + 1] = offsets[length] + h->count[length];
+    }
+    for (int s = 0; s < count; s++)
+    {
+        if (lengths[s] != 0)
+        {
+            h->symbol[offsets[lengths[s]]++] = s;
+        }
+    }
+
+    // codes short enough for the fast table fill every entry whose low bits are the code, bit reversed
+    // since the stream is read least significant bit first
+    memset(h->fast, 0, sizeof(h->fast));
+    int code = 0;
+    int index = 0;
+    for (int length = 1; length <= HUFFMAN_FAST_BITS; length++)
+    {
+        for (int k = 0; k < h->count[length]; k++, code++, index++)
+        {
+            int reversed = 0;
+            for (int b = 0; b < length; b++)
+            {
+                reversed |= (code >> b & 1) << (length - 1 - b);
+            }
+            for (int fill = reversed; fill < 1 << HUFFMAN_FAST_BITS; fill += 1 << length)
+            {
+                h->fast[fill] = h->symbol[index] << 4 | length;
+            }
+        }
+        code <<= 1;
+    }
+
+    return 0;
+}
+
+// reads the header of the next block and gets ready to inflate it, returns 1 if it's broken
+int readBlockHeader (INFLATE *z)
+{
+    int last = takeBits(z, 1);
+    int type = takeBits(z, 2);
+    if (last < 0 || type < 0)
+    {
+        return 1;
+    }
+    z->last = last;
+
+    if (type == 0)
+    {
+        // stored bytes start at the next whole byte, after their length and its complement
+        takeBits(z, z->bitCount & 7);
+        int length = takeBits(z, 16);
+        int complement = takeBits(z, 16);
+        if (length < 0 || complement < 0 || length != (~complement & 0xffff))
+        {
+            return 1;
+        }
+        z->stored = length;
+        z->state = INFLATE_STORED;
+        return 0;
+    }
+
+    if (type == 1)
+    {
+        uint8_t lengths[288 + 30];
+        memset(lengths, 8, 144);
+        memset(lengths + 144, 9, 112);
+        memset(lengths + 256, 7, 24);
+        memset(lengths + 280, 8, 8);
+        memset(lengths + 288, 5, 30);
+        buildHuffman(&z->literals, lengths, 288);
+        buildHuffman(&z->distances, lengths + 288, 30);
+        z->state = INFLATE_CODES;
+        return 0;
+    }
+
+    if (type == 2 && readDynamicCodes(z) == 0)
+    {
+        z->state = INFLATE_CODES;
+        return 0;
+    }
+
+    return 1;
+}
+
+// reads the code lengths of a block's own literal and distance codes, themselves Huffman coded, and builds
+// them, returns 1 if they're broken
+int readDynamicCodes (INFLATE *z)
+{
+    int literalCount = takeBits(z, 5) + 257;
+    int distanceCount = takeBits(z, 5) + 1;
+    int lengthCount = takeBits(z, 4) + 4;
+    if (literalCount < 257 || distanceCount < 1 || lengthCount < 4 || literalCount > 286 || distanceCount > 30)
+    {
+        return 1;
+    }
+
+    uint8_t lengths[288 + 32] = {0};
+    for (int i = 0; i < lengthCount; i++)
+    {
+        int length = takeBits(z, 3);
+        if (length < 0)
+        {
+            return 1;
+        }
+        lengths[lengthOrder[i]] = length;
+    }
+    HUFFMAN lengthCode;
+    if (buildHuffman(&lengthCode, lengths, 19) != 0)
+    {
+        return 1;
+    }
+
+    // literal and distance code lengths run on from one to the other, with runs of repeats and zeroes
+    memset(lengths, 0, sizeof(lengths));
+    int index = 0;
+    while (index < literalCount + distanceCount)
+    {
+        int symbol = decodeSymbol(z, &lengthCode);
+        if (symbol < 0)
+        {
+            return 1;
+        }
+        if (symbol < 16)
+        {
+            lengths[index++] = symbol;
+            continue;
+        }
+
+        // 16 repeats the last length 3 to 6 times, 17 and 18 are 3 to 10 and 11 to 138 zeroes
+        int length = symbol == 16 && index > 0 ? lengths[index - 1] : 0;
+        int extra = takeBits(z, symbol == 16 ? 2 : symbol == 17 ? 3 : 7);
+        int repeat = (symbol == 18 ? 11 : 3) + extra;
+        if ((symbol == 16 && index == 0) || extra < 0 || index + repeat > literalCount + distanceCount)
+        {
+            return 1;
+        }
+        memset(lengths + index, length, repeat);
+        index += repeat;
+    }
+
+    // the end of block code has to be there
+    if (lengths[256] == 0 || buildHuffman(&z->literals, lengths, literalCount) != 0 ||
+        buildHuffman(&z->distances, lengths + literalCount, distanceCount) != 0)
+    {
+        return 1;
+    }
+    return 0;
+}
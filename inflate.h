@@ -0,0 +1,60 @@
+// *******************************************************************************************************
+// Inflates a zlib stream (RFC 1950/1951) a piece at a time, pulling its compressed bytes from a source as
+// they are needed, so an image can be decompressed one scanline at a time without holding the whole of it.
+// *******************************************************************************************************
+
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// how far back a match can reach
+#define INFLATE_WINDOW 32768
+
+// most bits a code can take
+#define HUFFMAN_BITS 15
+
+// codes of up to this many bits are looked up in one go, longer ones a bit at a time
+#define HUFFMAN_FAST_BITS 9
+
+// a canonical Huffman code: how many codes there are of each length and the symbols in code order, with
+// fast looking up (symbol << 4 | length) by the first HUFFMAN_FAST_BITS bits of the stream (0 for a longer
+// code)
+typedef struct
+{
+    short count[HUFFMAN_BITS + 1];
+    short symbol[288];
+    uint16_t fast[1 << HUFFMAN_FAST_BITS];
+}
+HUFFMAN;
+
+// where an inflate is up to: the bits read from the source but not yet used, the block being inflated
+// (stored bytes left of a stored block, or its codes and any part of a match still to copy) and the last
+// INFLATE_WINDOW bytes inflated, fill hands out the next piece of compressed bytes from source and returns
+// false when there are no more
+typedef struct
+{
+    bool (*fill) (void *source, const uint8_t **next, size_t *available);
+    void *source;
+    const uint8_t *next;
+    size_t available;
+    uint64_t bits;
+    int bitCount;
+    int state;
+    bool last;
+    size_t stored;
+    int length;
+    int distance;
+    HUFFMAN literals;
+    HUFFMAN distances;
+    uint8_t window[INFLATE_WINDOW];
+    size_t position;
+}
+INFLATE;
+
+void startInflate (INFLATE *z, bool (*fill) (void *source, const uint8_t **next, size_t *available), void *source);
+int inflateBytes (INFLATE *z, uint8_t *out, size_t count);
+
+#endif
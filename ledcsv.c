@@ -1,1589 +1,822 @@
 // *******************************************************************************************************
-// Takes a 24-bit BMP file and scales it to a 43x42 px temp file (temp.bmp) and then outputs a named csv
-// file (2nd argument) with RGB values for 320 premapped LED lights for a HERA display.
+// Takes a BMP, PNG, PPM, PGM or PAM file (or raw RGB, from stdin with -) and scales it to a 43x42 px image
+// in memory (written to temp.bmp with -t) and then outputs a named csv file (2nd argument) with RGB values
+// for 320 premapped LED lights for a HERA display (or the image size and LEDs of a layout file given with -m),
+// or a frame of them for every frame of an animated GIF.
 // *******************************************************************************************************
 
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-#include "bmp.h"
+#include "convert.h"
 
-int getLEDIndex (int x, int y);
+// how many frames of a sequence are converted at a time
+#define SEQUENCE_CHUNK 256
+
+// jobs handed out one at a time to batch worker threads, each either an image and csv name pair from files
+// or a frame name from files whose LED values go into leds, status is the first non-zero exit status of any job
+typedef struct batch
+{
+    char **files;
+    int count;
+    OPTIONS *options;
+    RGBTRIPLE (*leds)[LED_MAX_COUNT];
+    int (*convert) (struct batch *batch, int job, WORKSPACE *space);
+    pthread_mutex_t lock;
+    int next;
+    int status;
+}
+BATCH;
+
+int convertFile (char *infile, char *outfile, OPTIONS *options, WORKSPACE *space);
+int convertAnimation (FILE *inptr, char *infile, char *outfile, OPTIONS *options, WORKSPACE *space);
+int convertSequence (char *pattern, int first, char *outfile, OPTIONS *options, int threads);
+int convertStream (char *outfile, OPTIONS *options, int threads);
+int convertPair (BATCH *batch, int job, WORKSPACE *space);
+int convertFrame (BATCH *batch, int job, WORKSPACE *space);
+bool validPattern (char *pattern);
+int runBatch (BATCH *batch, int threads);
+void *batchWorker (void *arg);
+int addFile (char *name, char ***files, int *count);
+void freeFiles (char **files, int count);
+int readList (char *listfile, char ***files, int *count);
 
 int main(int argc, char *argv[])
 {
-    // ensure proper usage
-    if (argc != 3)
+    char *usage = "Usage: ./ledcsv [-f | -t] [-k kernel] [-b [-r fps]] [-j threads] [-l list] [-m layout] "
+                  "[--background rrggbb] [--raw WxH] [--stats] [<image name or - (input)> <csv file (output)>]...\n"
+                  "       ./ledcsv -s first [-f | -k kernel] [-b [-r fps]] [-j threads] [-m layout] "
+                  "[--background rrggbb] [--raw WxH] [--stats] <frame name pattern or - (input)> "
+                  "<csv file (output)>\n"
+                  "kernels: area (default), bilinear, lanczos, gaussian\n";
+
+    // long options have no short form
+    static struct option longOptions[] =
     {
-        fprintf(stderr, "Usage: ./ledcsv <bmp image name (input)> <csv file (output)>\n");
-        return 1;
-    }
+        {"background", required_argument, NULL, 'B'},
+        {"raw", required_argument, NULL, 'R'},
+        {"stats", no_argument, NULL, 'S'},
+        {NULL, 0, NULL, 0}
+    };
 
-    // remember filenames
-    char *infile = argv[1];
-    char *tempfile = "temp.bmp";
-    char *outfile = argv[2];
+    // the whole run is timed for --stats
+    double start = now();
+    STATS stats = {0};
 
-    // open input file
-    FILE *inptr = fopen(infile, "r");
-    if (inptr == NULL)
+    OPTIONS options =
     {
-        fprintf(stderr, "Could not open %s.\n", infile);
-        return 2;
-    }
+        // the scaled image is only written out to temp.bmp when asked for
+        .writeTemp = false,
 
-    // open temp file to create scaled image
-    FILE *tempptr = fopen(tempfile, "w");
-    if (tempptr == NULL)
-    {
-        fclose(inptr);
-        fprintf(stderr, "Could not create %s.\n", tempfile);
-        return 3;
-    }
+        // fused mode skips the scaled image and gathers infile straight into the LEDs
+        .fused = false,
 
-    // open output file
-    FILE *outptr = fopen(outfile, "w");
-    if (outptr == NULL)
-    {
-        fclose(inptr);
-        fclose(tempptr);
-        fprintf(stderr, "Could not create %s.\n", outfile);
-        return 4;
-    }
+        .threads = 1,
 
-    // read infile's BITMAPFILEHEADER
-    BITMAPFILEHEADER bf;
-    fread(&bf, sizeof(BITMAPFILEHEADER), 1, inptr);
+        // binary frames instead of csv lines, with the frame rate recorded in the header
+        .binary = false,
+        .fps = 0,
 
-    // read infile's BITMAPINFOHEADER
-    BITMAPINFOHEADER bi;
-    fread(&bi, sizeof(BITMAPINFOHEADER), 1, inptr);
+        // how infile is scaled down, the exact area average unless a smoothing filter is picked
+        .kernel = KERNEL_AREA,
 
-    // ensure infile is (likely) a 24-bit uncompressed BMP 4.0
-    if (bf.bfType != 0x4d42 || bf.bfOffBits != 54 || bi.biSize != 40 ||
-        bi.biBitCount != 24 || bi.biCompression != 0)
-    {
-        fclose(outptr);
-        fclose(inptr);
-        fclose(tempptr);
-        fprintf(stderr, "Unsupported input file format.  Needs to be 24-bit Bitmap file (.bmp, use Paint to convert)\n");
-        return 5;
-    }
+        // infile has headers unless --raw gives the size of its pixels
+        .rawWidth = 0,
+        .rawHeight = 0,
 
-    // edit temp file's headers
-    BITMAPFILEHEADER obf = bf;
-    BITMAPINFOHEADER obi = bi;
+        // alpha in 32-bit images is ignored unless there's a background to blend it into
+        .blend = false,
 
-    // dimensions of scaled image are predetermined
-    obi.biWidth = 43;
-    obi.biHeight = 42;
+        // per-stage timings and counters, only collected with --stats
+        .stats = NULL
+    };
 
-    // determine padding for scanlines
-    int padding = (4 - (bi.biWidth * sizeof(RGBTRIPLE)) % 4) % 4;
-    int oPadding = (4 - (obi.biWidth * sizeof(RGBTRIPLE)) % 4) % 4;
+    // number of threads sharing the work, 0 means one per online CPU
+    long threads = 1;
 
-    // determine how many pixels are being discarded at the end of the row
-    int cropping = (bi.biWidth % obi.biWidth) * sizeof(RGBTRIPLE);
+    // image and csv names, in pairs, from the command line and any list files
+    char **files = NULL;
+    int fileCount = 0;
 
-    obi.biSizeImage = ((sizeof(RGBTRIPLE) * obi.biWidth) + oPadding) * abs(obi.biHeight);
-    obf.bfSize = obi.biSizeImage + sizeof(BITMAPINFOHEADER) + sizeof(BITMAPFILEHEADER);
+    // sequence mode reads numbered frames starting from first into one csv
+    bool sequence = false;
+    long first = 0;
 
-    // write temp file's BITMAPFILEHEADER
-    fwrite(&obf, sizeof(BITMAPFILEHEADER), 1, tempptr);
+    // colour that alpha is blended into with --background
+    long background;
 
-    // write temp file's BITMAPINFOHEADER
-    fwrite(&obi, sizeof(BITMAPINFOHEADER), 1, tempptr);
+    // file describing the display's layout, the HERA display's is built in
+    char *layoutfile = NULL;
 
-    int xIndex = 0;
-    long red[43] = {0};
-    long blue[43] = {0};
-    long green[43] = {0};
+    int opt;
+    char *end;
+    while ((opt = getopt_long(argc, argv, "bfj:k:l:m:r:s:t", longOptions, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'B':
+                if (strspn(optarg, "0123456789abcdefABCDEF") != 6 || optarg[6] != '\0')
+                {
+                    fprintf(stderr, "%s", usage);
+                    freeFiles(files, fileCount);
+                    return 1;
+                }
+                background = strtol(optarg, NULL, 16);
+                options.blend = true;
+                options.background.rgbtRed = background >> 16;
+                options.background.rgbtGreen = background >> 8 & 0xff;
+                options.background.rgbtBlue = background & 0xff;
+                break;
+
+            case 'R':
+                options.rawWidth = strtol(optarg, &end, 10);
+                if (*end == 'x')
+                {
+                    options.rawHeight = strtol(end + 1, &end, 10);
+                }
+                if (*end != '\0' || options.rawWidth < 1 || options.rawWidth > INT32_MAX || options.rawHeight < 1 ||
+                    options.rawHeight > INT32_MAX)
+                {
+                    fprintf(stderr, "%s", usage);
+                    freeFiles(files, fileCount);
+                    return 1;
+                }
+                break;
+
+            case 'S':
+                options.stats = &stats;
+                break;
+
+            case 'b':
+                options.binary = true;
+                break;
+
+            case 'f':
+                options.fused = true;
+                break;
+
+            case 'j':
+                threads = strtol(optarg, &end, 10);
+                if (*end != '\0' || threads < 0 || threads > INT_MAX)
+                {
+                    fprintf(stderr, "%s", usage);
+                    freeFiles(files, fileCount);
+                    return 1;
+                }
+                break;
+
+            case 'k':
+                options.kernel = findKernel(optarg);
+                if (options.kernel == -1)
+                {
+                    fprintf(stderr, "%s", usage);
+                    freeFiles(files, fileCount);
+                    return 1;
+                }
+                break;
+
+            case 'l':
+                if (readList(optarg, &files, &fileCount) != 0)
+                {
+                    freeFiles(files, fileCount);
+                    return 1;
+                }
+                break;
+
+            case 'm':
+                layoutfile = optarg;
+                break;
+
+            case 'r':
+                options.fps = strtol(optarg, &end, 10);
+                if (*end != '\0' || options.fps < 0 || options.fps > UINT16_MAX)
+                {
+                    fprintf(stderr, "%s", usage);
+                    freeFiles(files, fileCount);
+                    return 1;
+                }
+                break;
+
+            case 's':
+                sequence = true;
+                first = strtol(optarg, &end, 10);
+                if (*end != '\0' || first < 0 || first > INT_MAX)
+                {
+                    fprintf(stderr, "%s", usage);
+                    freeFiles(files, fileCount);
+                    return 1;
+                }
+                break;
+
+            case 't':
+                options.writeTemp = true;
+                break;
+
+            default:
+                fprintf(stderr, "%s", usage);
+                freeFiles(files, fileCount);
+                return 1;
+        }
+    }
 
-    // figure out how many rows and columns of pixels from infile will make up 1 pixel in scaled image
-    long pxColumns = bi.biWidth / obi.biWidth;
-    long pxRows = bi.biHeight / obi.biHeight;
+    if (threads == 0)
+    {
+        threads = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    }
 
-    // iterate over infile's scanlines
-    for (int i = 0; i < pxRows * obi.biHeight; i++)
+    for (int i = optind; i < argc; i++)
     {
-        // iterate over pixels in scanline row
-        for (int j = 0; j < pxColumns * obi.biWidth; j++)
+        if (addFile(argv[i], &files, &fileCount) != 0)
         {
-            RGBTRIPLE triple;
-
-            // read RGB triple from infile
-            fread(&triple, sizeof(RGBTRIPLE), 1, inptr);
-
-            // determine which pixel this will translate to for the temp scaled image
-            xIndex = j / pxColumns;
-
-            // sum the RBG values that will correspond to pixels for the output file
-            red[xIndex] += triple.rgbtRed;
-            green[xIndex] += triple.rgbtGreen;
-            blue[xIndex] += triple.rgbtBlue;
+            fprintf(stderr, "Not enough memory.\n");
+            freeFiles(files, fileCount);
+            return 1;
         }
+    }
 
-        // discard the excess pixels on this row
-        fseek(inptr, cropping, SEEK_CUR);
-
-        // skip over input file padding, if any
-        fseek(inptr, padding, SEEK_CUR);
+    // ensure proper usage, there is no scaled image to write (or filter) in fused mode and only one image can
+    // have it written
+    if (fileCount == 0 || fileCount % 2 != 0 || (options.writeTemp && (options.fused || fileCount != 2)) ||
+        (options.fused && options.kernel != KERNEL_AREA))
+    {
+        fprintf(stderr, "%s", usage);
+        freeFiles(files, fileCount);
+        return 1;
+    }
 
-        // check if we have reached the next row of pixels for output file
-        if (((i + 1) / pxRows) > (i / pxRows))
-        {
-            for (int x = 0; x < obi.biWidth; x++)
-            {
-                RGBTRIPLE triple;
+    // the scaled image and LEDs every image is converted to
+    if (loadLayout(layoutfile) != 0)
+    {
+        freeFiles(files, fileCount);
+        return 1;
+    }
 
-                // average the RGB values gathered above and write row to temp scaled image
-                triple.rgbtRed = red[x] / (pxColumns * pxRows);
-                triple.rgbtGreen = green[x] / (pxColumns * pxRows);
-                triple.rgbtBlue = blue[x] / (pxColumns * pxRows);
+    // use the fastest pixel summing kernel this CPU supports
+    selectKernels();
 
-                fwrite(&triple, sizeof(RGBTRIPLE), 1, tempptr);
-            }
-            // add output padding
-            for (int j = 0; j < oPadding; j++)
-            {
-                fputc(0x00, tempptr);
-            }
+    // frames of a sequence are shared between the threads like a batch
+    if (sequence)
+    {
+        if (fileCount != 2 || options.writeTemp)
+        {
+            fprintf(stderr, "%s", usage);
+            freeFiles(files, fileCount);
+            return 1;
+        }
+        if (strcmp(files[0], "-") != 0 && !validPattern(files[0]))
+        {
+            fprintf(stderr, "Frame name pattern %s needs exactly one %%d for the frame number.\n", files[0]);
+            freeFiles(files, fileCount);
+            return 1;
+        }
 
-            // clear out old data and start fresh for next row
-            for (int x = 0; x < obi.biWidth; x++)
-            {
-                red[x] = 0;
-                green[x] = 0;
-                blue[x] = 0;
-            }
+        // frames piped in one after the other can only be read in turn
+        int status = strcmp(files[0], "-") == 0 ? convertStream(files[1], &options, threads)
+                                                : convertSequence(files[0], first, files[1], &options, threads);
+        if (options.stats != NULL)
+        {
+            printStats(&stats, now() - start);
         }
+        freeFiles(files, fileCount);
+        return status;
     }
 
-    // close infile
-    fclose(inptr);
-
-    // close tempfile
-    fclose(tempptr);
+    // a single image shares its bands between the threads, a batch gives each thread whole images
+    BATCH batch =
+    {
+        .files = files,
+        .count = fileCount / 2,
+        .options = &options,
+        .convert = convertPair
+    };
+    if (batch.count == 1)
+    {
+        options.threads = threads;
+        threads = 1;
+    }
+    for (int i = 0; i < batch.count && batch.count > 1; i++)
+    {
+        if (strcmp(files[2 * i], "-") == 0)
+        {
+            fprintf(stderr, "Only a single image or a sequence (-s) can be read from stdin.\n");
+            freeFiles(files, fileCount);
+            return 1;
+        }
+    }
 
-    // open scaled image for reading
-    FILE *scaled = fopen(tempfile, "r");
-    if (scaled == NULL)
+    int status = runBatch(&batch, threads);
+    if (options.stats != NULL)
     {
-        fprintf(stderr, "Could not open scaled image");
-        return 6;
+        printStats(&stats, now() - start);
     }
+    freeFiles(files, fileCount);
+    return status;
+}
 
-    // seek past scaled headers
-    fseek(scaled, sizeof(BITMAPFILEHEADER), SEEK_CUR);
-    fseek(scaled, sizeof(BITMAPINFOHEADER), SEEK_CUR);
+// converts one image to its csv file, returning the exit status for it
+int convertFile (char *infile, char *outfile, OPTIONS *options, WORKSPACE *space)
+{
+    double mark = now();
 
-    // set up structure for numbered LEDs
-    RGBTRIPLE *led = malloc(320 * sizeof(RGBTRIPLE));
-    long redSum[320];
-    long greenSum[320];
-    long blueSum[320];
-    for (int n = 0; n < 320; n++)
+    // open input file once, - reads the image from stdin, so a pipe can be read whatever kind of image it is
+    bool piped = strcmp(infile, "-") == 0;
+    FILE *inptr = piped ? stdin : fopen(infile, "r");
+    if (inptr == NULL)
     {
-        redSum[n] = 0;
-        greenSum[n] = 0;
-        blueSum[n] = 0;
-        led[n].rgbtRed = 0;
-        led[n].rgbtGreen = 0;
-        led[n].rgbtBlue = 0;
+        fprintf(stderr, "Could not open %s.\n", infile);
+        return 2;
     }
-    int ledNumber;
 
-    // iterate over scaled file's scanlines
-    for (int i = obi.biHeight - 1; i >= 0; i--)
+    // an animated GIF gets a frame for every frame of it
+    if (isAnimation(inptr, options))
     {
-        // iterate over pixels in scanline
-        for (int j = 0; j < obi.biWidth; j++)
+        int status = convertAnimation(inptr, infile, outfile, options, space);
+        if (!piped)
         {
-            RGBTRIPLE triple;
-
-            // read RGB triple from infile
-            fread(&triple, sizeof(RGBTRIPLE), 1, scaled);
-
-            // only save info on valid LEDs from the scaled image
-            ledNumber = getLEDIndex(j, i);
-            if (ledNumber != -1)
-            {
-                // sum RBG values for averaging later
-                redSum[ledNumber] += triple.rgbtRed;
-                greenSum[ledNumber] += triple.rgbtGreen;
-                blueSum[ledNumber] += triple.rgbtBlue;
-            }
+            fclose(inptr);
         }
+        return status;
+    }
+
+    // set up structure for numbered LEDs
+    RGBTRIPLE led[LED_MAX_COUNT];
 
-        // skip over scaled file padding, if any
-        fseek(scaled, oPadding, SEEK_CUR);
+    int status = convertInput(inptr, infile, led, options, space, lap(&mark));
+    if (!piped)
+    {
+        fclose(inptr);
+    }
+    if (status != 0)
+    {
+        return status;
     }
 
-    // create named csv output file with above RGB values
-    for (int n = 0; n < 320; n++)
+    STATS output = {0};
+    mark = now();
+
+    // open output file
+    FILE *outptr = fopen(outfile, "w");
+    if (outptr == NULL)
     {
-        led[n].rgbtRed = (redSum[n] / 4);
-        led[n].rgbtGreen = (greenSum[n] / 4);
-        led[n].rgbtBlue = (blueSum[n] / 4);
-        fprintf(outptr, "%i, %i, %i, %i", n, led[n].rgbtRed, led[n].rgbtGreen, led[n].rgbtBlue);
-        if (n < 319)
-        {
-            fprintf(outptr, "\n");
-        }
+        fprintf(stderr, "Could not create %s.\n", outfile);
+        return 4;
     }
 
-    fclose(scaled);
+    // create named csv (or binary) output file with above RGB values
+    output.bytesWritten = startOutput(outptr, 1, options);
+    output.bytesWritten += writeFrame(outptr, led, 0, options);
+
     fclose(outptr);
 
+    output.output = lap(&mark);
+    addStats(options->stats, &output);
+
     // success
     return 0;
 }
 
-// maps specific x,y coordinates of the pixels from scaled image to predetermined LED numbers for csv
-int getLEDIndex (int x, int y)
+// converts every frame of an animated GIF into one csv file with a block of lines per frame, each frame
+// repeated for as long as its delay lasts at the frame rate: -r, or else the slowest rate that every delay
+// is a whole number of frames at (which goes in the header of a binary file), the GIF is read from inptr,
+// returning the exit status
+int convertAnimation (FILE *inptr, char *infile, char *outfile, OPTIONS *options, WORKSPACE *space)
 {
-    if (y == 0 || y == 1)
+    ANIMATION *gif = malloc(sizeof(ANIMATION));
+    if (gif == NULL)
     {
-        if (x == 9 || x == 10)
-        {
-            return 220;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 219;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 218;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 217;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 216;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 215;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 214;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 213;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 212;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 211;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 210;
-        }
+        fprintf(stderr, "Not enough memory.\n");
+        return 7;
     }
-    else if (y == 2 || y == 3)
+    int status = openAnimation(gif, inptr, infile, options);
+    if (status != 0)
     {
-        if (x == 8 || x == 9)
-        {
-            return 221;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 222;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 223;
-        }
-        else if (x == 14 || x == 15)
+        free(gif);
+        return status;
+    }
+
+    // delays are in hundredths of a second
+    OPTIONS timed = *options;
+    if (timed.fps == 0)
+    {
+        int unit = 100;
+        for (int i = 0; i < gif->frameCount; i++)
         {
-            return 224;
+            for (int delay = gif->delays[i]; delay != 0;)
+            {
+                int rest = unit % delay;
+                unit = delay;
+                delay = rest;
+            }
         }
-        else if (x == 16 || x == 17)
+        timed.fps = 100 / unit;
+    }
+
+    // open output file
+    FILE *outptr = fopen(outfile, "w");
+    if (outptr == NULL)
+    {
+        closeAnimation(gif);
+        free(gif);
+        fprintf(stderr, "Could not create %s.\n", outfile);
+        return 4;
+    }
+
+    // the frame count isn't known until every frame is decoded
+    STATS output = {0};
+    output.bytesWritten = startOutput(outptr, 0, &timed);
+
+    // a frame is written out for every tick of the frame rate up to the end of its delay, so a short one
+    // can be passed over altogether when the rate is slow
+    long elapsed = 0;
+    int frames = 0;
+    for (int i = 0; i < gif->frameCount && status == 0; i++)
+    {
+        if (nextAnimationFrame(gif) != 0)
         {
-            return 225;
+            fprintf(stderr, "Could not read %s.\n", infile);
+            status = 7;
+            break;
         }
-        else if (x == 18 || x == 19)
+        elapsed += gif->delays[i];
+        long until = (elapsed * timed.fps + 99) / 100;
+        if (frames == until)
         {
-            return 226;
+            continue;
         }
-        else if (x == 20 || x == 21)
+
+        RGBTRIPLE led[LED_MAX_COUNT];
+        status = convertCanvas(gif, infile, led, &timed, space);
+        double mark = now();
+        for (; frames < until && status == 0; frames++)
         {
-            return 227;
+            output.bytesWritten += writeFrame(outptr, led, frames, &timed);
         }
-        else if (x == 22 || x == 23)
+        output.output += lap(&mark);
+    }
+
+    double mark = now();
+    finishOutput(outptr, frames, &timed);
+
+    fclose(outptr);
+    output.output += lap(&mark);
+    addStats(options->stats, &output);
+    closeAnimation(gif);
+    free(gif);
+    return status;
+}
+
+// converts frames named by pattern (with the frame number filled in), numbered from first up to the first
+// one that is missing, into one csv file with a block of lines per frame, returning the exit status
+int convertSequence (char *pattern, int first, char *outfile, OPTIONS *options, int threads)
+{
+    // frames are converted a chunk at a time, each chunk shared out between the threads like a batch
+    size_t nameSize = strlen(pattern) + 32;
+    char *names[SEQUENCE_CHUNK];
+    char *nameBlock = malloc(SEQUENCE_CHUNK * nameSize);
+    RGBTRIPLE (*leds)[LED_MAX_COUNT] = malloc(SEQUENCE_CHUNK * sizeof(*leds));
+    if (nameBlock == NULL || leds == NULL)
+    {
+        free(nameBlock);
+        free(leds);
+        fprintf(stderr, "Not enough memory.\n");
+        return 7;
+    }
+    for (int i = 0; i < SEQUENCE_CHUNK; i++)
+    {
+        names[i] = nameBlock + i * nameSize;
+    }
+
+    // open output file
+    FILE *outptr = fopen(outfile, "w");
+    if (outptr == NULL)
+    {
+        free(nameBlock);
+        free(leds);
+        fprintf(stderr, "Could not create %s.\n", outfile);
+        return 4;
+    }
+
+    // the frame count isn't known yet
+    STATS output = {0};
+    output.bytesWritten = startOutput(outptr, 0, options);
+
+    int status = 0;
+    int frames = 0;
+    bool done = false;
+    while (!done && status == 0)
+    {
+        // collect the next chunk of frames, the first missing frame number ends the sequence
+        int count = 0;
+        while (count < SEQUENCE_CHUNK)
         {
-            return 228;
+            snprintf(names[count], nameSize, pattern, first + frames + count);
+            if (access(names[count], F_OK) != 0)
+            {
+                done = true;
+                break;
+            }
+            count++;
         }
-        else if (x == 24 || x == 25)
+
+        BATCH batch =
         {
-            return 229;
-        }
-        else if (x == 26 || x == 27)
+            .files = names,
+            .count = count,
+            .options = options,
+            .leds = leds,
+            .convert = convertFrame
+        };
+        status = runBatch(&batch, threads);
+
+        double mark = now();
+        for (int i = 0; i < count && status == 0; i++)
         {
-            return 230;
+            output.bytesWritten += writeFrame(outptr, leds[i], frames + i, options);
         }
-        else if (x == 28 || x == 29)
+        output.output += lap(&mark);
+        frames += count;
+    }
+
+    // the sequence has to have at least its first frame
+    if (status == 0 && frames == 0)
+    {
+        fprintf(stderr, "Could not open %s.\n", names[0]);
+        status = 2;
+    }
+
+    double mark = now();
+    finishOutput(outptr, frames, options);
+
+    fclose(outptr);
+    output.output += lap(&mark);
+    addStats(options->stats, &output);
+    free(nameBlock);
+    free(leds);
+    return status;
+}
+
+// converts frames piped in on stdin one after the other, up to the end of it, into one csv file with a block
+// of lines per frame, each frame's bands shared between the threads, returning the exit status
+int convertStream (char *outfile, OPTIONS *options, int threads)
+{
+    WORKSPACE *space = calloc(1, sizeof(WORKSPACE));
+    if (space == NULL)
+    {
+        fprintf(stderr, "Not enough memory.\n");
+        return 7;
+    }
+    options->threads = threads;
+
+    // open output file
+    FILE *outptr = fopen(outfile, "w");
+    if (outptr == NULL)
+    {
+        free(space);
+        fprintf(stderr, "Could not create %s.\n", outfile);
+        return 4;
+    }
+
+    // the frame count isn't known yet
+    STATS output = {0};
+    output.bytesWritten = startOutput(outptr, 0, options);
+
+    int status = 0;
+    int frames = 0;
+    while (status == 0)
+    {
+        // the end of stdin ends the sequence
+        int c = getc(stdin);
+        if (c == EOF)
         {
-            return 231;
+            break;
         }
-        else if (x == 32 || x == 33)
+        ungetc(c, stdin);
+
+        RGBTRIPLE led[LED_MAX_COUNT];
+        status = convertImage("-", led, options, space);
+        if (status == 0)
         {
-            return 209;
+            double mark = now();
+            output.bytesWritten += writeFrame(outptr, led, frames, options);
+            output.output += lap(&mark);
+            frames++;
         }
     }
-    else if (y == 4 || y == 5)
+
+    // the sequence has to have at least one frame
+    if (status == 0 && frames == 0)
+    {
+        fprintf(stderr, "No frames on stdin.\n");
+        status = 2;
+    }
+
+    double mark = now();
+    finishOutput(outptr, frames, options);
+
+    fclose(outptr);
+    output.output += lap(&mark);
+    addStats(options->stats, &output);
+    freeWorkspace(space);
+    return status;
+}
+
+// batch job that converts an image to its csv file
+int convertPair (BATCH *batch, int job, WORKSPACE *space)
+{
+    return convertFile(batch->files[2 * job], batch->files[2 * job + 1], batch->options, space);
+}
+
+// batch job that converts one frame of a sequence into its slot of the batch's LED values
+int convertFrame (BATCH *batch, int job, WORKSPACE *space)
+{
+    return convertImage(batch->files[job], batch->leds[job], batch->options, space);
+}
+
+// makes sure a frame name pattern is safe to hand to printf with the frame number: it needs exactly one %d,
+// optionally zero padded to a width (like %04d), and no other conversions except %%
+bool validPattern (char *pattern)
+{
+    int conversions = 0;
+    for (char *c = pattern; *c != '\0'; c++)
     {
-        if (x == 7 || x == 8)
+        if (*c != '%')
         {
-            return 242;
+            continue;
         }
-        else if (x == 9 || x == 10)
+
+        c++;
+        if (*c == '%')
         {
-            return 241;
+            continue;
         }
-        else if (x == 11 || x == 12)
+        while (*c >= '0' && *c <= '9')
         {
-            return 240;
+            c++;
         }
-        else if (x == 13 || x == 14)
+        if (*c != 'd')
         {
-            return 239;
+            return false;
         }
-        else if (x == 15 || x == 16)
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+// converts every image in the batch on the given number of threads, returning the first non-zero exit
+// status of any image (the rest are still converted)
+int runBatch (BATCH *batch, int threads)
+{
+    pthread_mutex_init(&batch->lock, NULL);
+    batch->next = 0;
+    batch->status = 0;
+
+    // there is no point in more threads than images, though an empty batch still needs the calling thread
+    if (threads > batch->count)
+    {
+        threads = batch->count > 0 ? batch->count : 1;
+    }
+
+    // if a thread can't be started the remaining ones just pick up its images
+    pthread_t *helpers = malloc((threads - 1) * sizeof(pthread_t));
+    int started = 0;
+    while (helpers != NULL && started < threads - 1 && pthread_create(&helpers[started], NULL, batchWorker, batch) == 0)
+    {
+        started++;
+    }
+
+    batchWorker(batch);
+
+    for (int t = 0; t < started; t++)
+    {
+        pthread_join(helpers[t], NULL);
+    }
+    free(helpers);
+
+    pthread_mutex_destroy(&batch->lock);
+    return batch->status;
+}
+
+// worker that converts images from the batch until there are none left, keeping one workspace throughout
+void *batchWorker (void *arg)
+{
+    BATCH *batch = arg;
+
+    WORKSPACE *space = calloc(1, sizeof(WORKSPACE));
+    if (space == NULL)
+    {
+        pthread_mutex_lock(&batch->lock);
+        fprintf(stderr, "Not enough memory.\n");
+        batch->status = batch->status ? batch->status : 7;
+        pthread_mutex_unlock(&batch->lock);
+        return NULL;
+    }
+
+    while (true)
+    {
+        pthread_mutex_lock(&batch->lock);
+        int job = batch->next < batch->count ? batch->next++ : -1;
+        pthread_mutex_unlock(&batch->lock);
+        if (job == -1)
         {
-            return 238;
+            break;
         }
-        else if (x == 17 || x == 18)
+
+        int status = batch->convert(batch, job, space);
+        if (status != 0)
         {
-            return 237;
+            pthread_mutex_lock(&batch->lock);
+            batch->status = batch->status ? batch->status : status;
+            pthread_mutex_unlock(&batch->lock);
         }
-        else if (x == 19 || x == 20)
+    }
+
+    freeWorkspace(space);
+    return NULL;
+}
+
+// appends a copy of one name to the list of image and csv names
+int addFile (char *name, char ***files, int *count)
+{
+    char *copy = strdup(name);
+    char **grown = copy == NULL ? NULL : realloc(*files, (*count + 1) * sizeof(char *));
+    if (grown == NULL)
+    {
+        free(copy);
+        return 1;
+    }
+    grown[(*count)++] = copy;
+    *files = grown;
+    return 0;
+}
+
+// frees the list of image and csv names and the names in it
+void freeFiles (char **files, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        free(files[i]);
+    }
+    free(files);
+}
+
+// adds the image and csv names listed in listfile (- for stdin), one whitespace separated pair per line
+int readList (char *listfile, char ***files, int *count)
+{
+    FILE *list = strcmp(listfile, "-") == 0 ? stdin : fopen(listfile, "r");
+    if (list == NULL)
+    {
+        fprintf(stderr, "Could not open %s.\n", listfile);
+        return 1;
+    }
+
+    char *line = NULL;
+    size_t size = 0;
+    int lineNumber = 0;
+    int status = 0;
+    while (status == 0 && getline(&line, &size, list) != -1)
+    {
+        lineNumber++;
+
+        char *names[3];
+        int found = 0;
+        for (char *name = strtok(line, " \t\r\n"); name != NULL && found < 3; name = strtok(NULL, " \t\r\n"))
         {
-            return 236;
+            names[found++] = name;
         }
-        else if (x == 21 || x == 22)
+
+        // skip blank lines
+        if (found == 0)
         {
-            return 235;
+            continue;
         }
-        else if (x == 23 || x == 24)
+        if (found != 2)
         {
-            return 234;
+            fprintf(stderr, "Line %i of %s needs to be <bmp image name (input)> <csv file (output)>.\n",
+                    lineNumber, listfile);
+            status = 1;
+            break;
         }
-        else if (x == 25 || x == 26)
+
+        for (int i = 0; i < 2 && status == 0; i++)
         {
-            return 233;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 232;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 190;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 208;
-        }
-    }
-    else if (y == 6 || y == 7)
-    {
-        if (x == 6 || x == 7)
-        {
-            return 243;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 244;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 245;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 246;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 247;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 248;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 249;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 250;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 251;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 252;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 253;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 189;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 191;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 207;
-        }
-    }
-    else if (y == 8 || y == 9)
-    {
-        if (x == 5 || x == 6)
-        {
-            return 264;
-        }
-        else if (x == 7 || x == 8)
-        {
-            return 263;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 262;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 261;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 260;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 259;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 258;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 257;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 256;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 255;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 254;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 170;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 188;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 192;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 206;
-        }
-    }
-    else if (y == 10 || y == 11)
-    {
-        if (x == 4 || x == 5)
-        {
-            return 265;
-        }
-        else if (x == 6 || x == 7)
-        {
-            return 266;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 267;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 268;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 269;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 270;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 271;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 272;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 273;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 274;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 275;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 169;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 171;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 187;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 193;
-        }
-        else if (x == 36 || x == 37)
-        {
-            return 205;
-        }
-    }
-    else if (y == 12 || y == 13)
-    {
-        if (x == 3 || x == 4)
-        {
-            return 286;
-        }
-        else if (x == 5 || x == 6)
-        {
-            return 285;
-        }
-        else if (x == 7 || x == 8)
-        {
-            return 284;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 283;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 282;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 281;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 280;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 279;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 278;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 277;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 276;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 150;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 168;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 172;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 186;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 194;
-        }
-        else if (x == 37 || x == 38)
-        {
-            return 204;
-        }
-    }
-    else if (y == 14 || y == 15)
-    {
-        if (x == 2 || x == 3)
-        {
-            return 287;
-        }
-        else if (x == 4 || x == 5)
-        {
-            return 288;
-        }
-        else if (x == 6 || x == 7)
-        {
-            return 289;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 290;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 291;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 292;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 293;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 294;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 295;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 296;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 297;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 149;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 151;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 167;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 173;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 185;
-        }
-        else if (x == 36 || x == 37)
-        {
-            return 195;
-        }
-        else if (x == 38 || x == 39)
-        {
-            return 203;
-        }
-    }
-    else if (y == 16 || y == 17)
-    {
-        if (x == 1 || x == 2)
-        {
-            return 308;
-        }
-        else if (x == 3 || x == 4)
-        {
-            return 307;
-        }
-        else if (x == 5 || x == 6)
-        {
-            return 306;
-        }
-        else if (x == 7 || x == 8)
-        {
-            return 305;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 304;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 303;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 302;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 301;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 300;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 299;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 298;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 130;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 148;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 152;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 166;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 174;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 184;
-        }
-        else if (x == 37 || x == 38)
-        {
-            return 196;
-        }
-        else if (x == 39 || x == 40)
-        {
-            return 202;
-        }
-    }
-    else if (y == 18 || y == 19)
-    {
-        if (x == 0 || x == 1)
-        {
-            return 309;
-        }
-        else if (x == 2 || x == 3)
-        {
-            return 310;
-        }
-        else if (x == 4 || x == 5)
-        {
-            return 311;
-        }
-        else if (x == 6 || x == 7)
-        {
-            return 312;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 313;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 314;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 315;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 316;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 317;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 318;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 319;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 129;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 131;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 147;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 153;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 165;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 175;
-        }
-        else if (x == 36 || x == 37)
-        {
-            return 183;
-        }
-        else if (x == 38 || x == 39)
-        {
-            return 197;
-        }
-        else if (x == 40 || x == 41)
-        {
-            return 201;
-        }
-    }
-    else if (y == 20 || y == 21)
-    {
-        if (x == 23 || x == 24)
-        {
-            return 110;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 128;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 132;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 146;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 154;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 164;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 176;
-        }
-        else if (x == 37 || x == 38)
-        {
-            return 182;
-        }
-        else if (x == 39 || x == 40)
-        {
-            return 198;
-        }
-        else if (x == 41 || x == 42)
-        {
-            return 200;
-        }
-    }
-    else if (y == 22 || y == 23)
-    {
-        if (x == 0 || x == 1)
-        {
-            return 99;
-        }
-        else if (x == 2 || x == 3)
-        {
-            return 100;
-        }
-        else if (x == 4 || x == 5)
-        {
-            return 101;
-        }
-        else if (x == 6 || x == 7)
-        {
-            return 102;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 103;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 104;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 105;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 106;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 107;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 108;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 109;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 111;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 127;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 133;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 145;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 155;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 163;
-        }
-        else if (x == 36 || x == 37)
-        {
-            return 177;
-        }
-        else if (x == 38 || x == 39)
-        {
-            return 181;
-        }
-        else if (x == 40 || x == 41)
-        {
-            return 199;
-        }
-    }
-    else if (y == 24 || y == 25)
-    {
-        if (x == 1 || x == 2)
-        {
-            return 98;
-        }
-        else if (x == 3 || x == 4)
-        {
-            return 97;
-        }
-        else if (x == 5 || x == 6)
-        {
-            return 96;
-        }
-        else if (x == 7 || x == 8)
-        {
-            return 95;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 94;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 93;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 92;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 91;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 90;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 89;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 88;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 112;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 126;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 134;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 144;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 156;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 162;
-        }
-        else if (x == 37 || x == 38)
-        {
-            return 178;
-        }
-        else if (x == 39 || x == 40)
-        {
-            return 180;
-        }
-    }
-    else if (y == 26 || y == 27)
-    {
-        if (x == 2 || x == 3)
-        {
-            return 77;
-        }
-        else if (x == 4 || x == 5)
-        {
-            return 78;
-        }
-        else if (x == 6 || x == 7)
-        {
-            return 79;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 80;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 81;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 82;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 83;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 84;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 85;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 86;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 87;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 113;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 125;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 135;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 143;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 157;
-        }
-        else if (x == 36 || x == 37)
-        {
-            return 161;
-        }
-        else if (x == 38 || x == 39)
-        {
-            return 179;
-        }
-    }
-    else if (y == 28 || y == 29)
-    {
-        if (x == 3 || x == 4)
-        {
-            return 76;
-        }
-        else if (x == 5 || x == 6)
-        {
-            return 75;
-        }
-        else if (x == 7 || x == 8)
-        {
-            return 74;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 73;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 72;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 71;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 70;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 69;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 68;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 67;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 66;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 114;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 124;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 136;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 142;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 158;
-        }
-        else if (x == 37 || x == 38)
-        {
-            return 160;
-        }
-    }
-    else if (y == 30 || y == 31)
-    {
-        if (x == 4 || x == 5)
-        {
-            return 55;
-        }
-        else if (x == 6 || x == 7)
-        {
-            return 56;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 57;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 58;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 59;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 60;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 61;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 62;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 63;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 64;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 65;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 115;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 123;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 137;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 141;
-        }
-        else if (x == 36 || x == 37)
-        {
-            return 159;
-        }
-    }
-    else if (y == 32 || y == 33)
-    {
-        if (x == 5 || x == 6)
-        {
-            return 54;
-        }
-        else if (x == 7 || x == 8)
-        {
-            return 53;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 52;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 51;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 50;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 49;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 48;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 47;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 46;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 45;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 44;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 116;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 122;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 138;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 140;
-        }
-    }
-    else if (y == 34 || y == 35)
-    {
-        if (x == 6 || x == 7)
-        {
-            return 33;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 34;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 35;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 36;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 37;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 38;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 39;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 40;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 41;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 42;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 43;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 117;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 121;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 139;
-        }
-    }
-    else if (y == 36 || y == 37)
-    {
-        if (x == 7 || x == 8)
-        {
-            return 32;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 31;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 30;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 29;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 28;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 27;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 26;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 25;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 24;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 23;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 22;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 118;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 120;
-        }
-    }
-    else if (y == 38 || y == 39)
-    {
-        if (x == 8 || x == 9)
-        {
-            return 11;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 12;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 13;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 14;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 15;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 16;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 17;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 18;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 19;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 20;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 21;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 119;
+            if (addFile(names[i], files, count) != 0)
+            {
+                fprintf(stderr, "Not enough memory to read %s.\n", listfile);
+                status = 1;
+            }
         }
     }
-    else if (y == 40 || y == 41)
+
+    free(line);
+    if (list != stdin)
     {
-        if (x == 9 || x == 10)
-        {
-            return 10;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 9;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 8;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 7;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 6;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 5;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 4;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 3;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 2;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 1;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 0;
-        }
+        fclose(list);
     }
-    return -1;
-}
\ No newline at end of file
+    return status;
+}
@@ -0,0 +1,26 @@
+#ifndef LEDFRAMES_H
+#define LEDFRAMES_H
+
+#include <stdint.h>
+
+// binary alternative to the csv output (ledcsv -b): this header followed by frameCount frames, each made
+// of ledCount packed red, green, blue byte triples in LED order, so a player can stream or map the file
+// and index frames directly, all fields are little-endian
+typedef struct
+{
+    uint8_t magic[4];
+    uint16_t version;
+    uint16_t ledCount;
+    uint32_t frameCount;
+    uint16_t fps;
+    uint16_t reserved;
+} __attribute__((__packed__))
+LEDFRAMESHEADER;
+
+// magic bytes at the start of every binary frame file
+#define LEDFRAMES_MAGIC "HERA"
+
+// version of the layout above
+#define LEDFRAMES_VERSION 1
+
+#endif
@@ -0,0 +1,227 @@
+// *******************************************************************************************************
+// Sets up the layout of LEDs on the scaled image, the HERA display's unless a layout file (like hera.layout)
+// describes another one, once at startup so every frame after that only looks up the tables it fills in.
+// *******************************************************************************************************
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ledmap.h"
+
+// size of the HERA display's scaled image and how many LEDs it has
+#define HERA_WIDTH 43
+#define HERA_HEIGHT 42
+#define HERA_LED_COUNT 320
+
+// biggest number readNumber keeps track of, anything over it is out of range anyway
+#define NUMBER_MAX 1000000
+
+LEDLAYOUT layout;
+
+int readNumber (FILE *file, long *value, int *line);
+int countPixels (const char *name);
+
+// maps x,y coordinates of the pixels in the HERA display's scaled image (y = 0 is the top row) to
+// predetermined LED numbers for the csv, -1 where there is no LED, see the HERA model in the README
+// each LED covers a 2x2 px section of the scaled image, offset by one pixel on alternating pairs of rows
+static const int16_t heraIndex[HERA_HEIGHT * HERA_WIDTH] =
+{
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,  220,  220,  219,  219,  218,  218,  217,  217,  216,  216,  215,  215,  214,  214,  213,  213,  212,  212,  211,  211,  210,  210,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,  220,  220,  219,  219,  218,  218,  217,  217,  216,  216,  215,  215,  214,  214,  213,  213,  212,  212,  211,  211,  210,  210,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,  221,  221,  222,  222,  223,  223,  224,  224,  225,  225,  226,  226,  227,  227,  228,  228,  229,  229,  230,  230,  231,  231,   -1,   -1,  209,  209,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,  221,  221,  222,  222,  223,  223,  224,  224,  225,  225,  226,  226,  227,  227,  228,  228,  229,  229,  230,  230,  231,  231,   -1,   -1,  209,  209,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,  242,  242,  241,  241,  240,  240,  239,  239,  238,  238,  237,  237,  236,  236,  235,  235,  234,  234,  233,  233,  232,  232,   -1,   -1,  190,  190,  208,  208,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,  242,  242,  241,  241,  240,  240,  239,  239,  238,  238,  237,  237,  236,  236,  235,  235,  234,  234,  233,  233,  232,  232,   -1,   -1,  190,  190,  208,  208,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,  243,  243,  244,  244,  245,  245,  246,  246,  247,  247,  248,  248,  249,  249,  250,  250,  251,  251,  252,  252,  253,  253,   -1,   -1,  189,  189,  191,  191,  207,  207,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,  243,  243,  244,  244,  245,  245,  246,  246,  247,  247,  248,  248,  249,  249,  250,  250,  251,  251,  252,  252,  253,  253,   -1,   -1,  189,  189,  191,  191,  207,  207,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,  264,  264,  263,  263,  262,  262,  261,  261,  260,  260,  259,  259,  258,  258,  257,  257,  256,  256,  255,  255,  254,  254,   -1,   -1,  170,  170,  188,  188,  192,  192,  206,  206,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,  264,  264,  263,  263,  262,  262,  261,  261,  260,  260,  259,  259,  258,  258,  257,  257,  256,  256,  255,  255,  254,  254,   -1,   -1,  170,  170,  188,  188,  192,  192,  206,  206,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,  265,  265,  266,  266,  267,  267,  268,  268,  269,  269,  270,  270,  271,  271,  272,  272,  273,  273,  274,  274,  275,  275,   -1,   -1,  169,  169,  171,  171,  187,  187,  193,  193,  205,  205,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,  265,  265,  266,  266,  267,  267,  268,  268,  269,  269,  270,  270,  271,  271,  272,  272,  273,  273,  274,  274,  275,  275,   -1,   -1,  169,  169,  171,  171,  187,  187,  193,  193,  205,  205,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,  286,  286,  285,  285,  284,  284,  283,  283,  282,  282,  281,  281,  280,  280,  279,  279,  278,  278,  277,  277,  276,  276,   -1,   -1,  150,  150,  168,  168,  172,  172,  186,  186,  194,  194,  204,  204,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,  286,  286,  285,  285,  284,  284,  283,  283,  282,  282,  281,  281,  280,  280,  279,  279,  278,  278,  277,  277,  276,  276,   -1,   -1,  150,  150,  168,  168,  172,  172,  186,  186,  194,  194,  204,  204,   -1,   -1,   -1,   -1,
+      -1,   -1,  287,  287,  288,  288,  289,  289,  290,  290,  291,  291,  292,  292,  293,  293,  294,  294,  295,  295,  296,  296,  297,  297,   -1,   -1,  149,  149,  151,  151,  167,  167,  173,  173,  185,  185,  195,  195,  203,  203,   -1,   -1,   -1,
+      -1,   -1,  287,  287,  288,  288,  289,  289,  290,  290,  291,  291,  292,  292,  293,  293,  294,  294,  295,  295,  296,  296,  297,  297,   -1,   -1,  149,  149,  151,  151,  167,  167,  173,  173,  185,  185,  195,  195,  203,  203,   -1,   -1,   -1,
+      -1,  308,  308,  307,  307,  306,  306,  305,  305,  304,  304,  303,  303,  302,  302,  301,  301,  300,  300,  299,  299,  298,  298,   -1,   -1,  130,  130,  148,  148,  152,  152,  166,  166,  174,  174,  184,  184,  196,  196,  202,  202,   -1,   -1,
+      -1,  308,  308,  307,  307,  306,  306,  305,  305,  304,  304,  303,  303,  302,  302,  301,  301,  300,  300,  299,  299,  298,  298,   -1,   -1,  130,  130,  148,  148,  152,  152,  166,  166,  174,  174,  184,  184,  196,  196,  202,  202,   -1,   -1,
+     309,  309,  310,  310,  311,  311,  312,  312,  313,  313,  314,  314,  315,  315,  316,  316,  317,  317,  318,  318,  319,  319,   -1,   -1,  129,  129,  131,  131,  147,  147,  153,  153,  165,  165,  175,  175,  183,  183,  197,  197,  201,  201,   -1,
+     309,  309,  310,  310,  311,  311,  312,  312,  313,  313,  314,  314,  315,  315,  316,  316,  317,  317,  318,  318,  319,  319,   -1,   -1,  129,  129,  131,  131,  147,  147,  153,  153,  165,  165,  175,  175,  183,  183,  197,  197,  201,  201,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,  110,  110,  128,  128,  132,  132,  146,  146,  154,  154,  164,  164,  176,  176,  182,  182,  198,  198,  200,  200,
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,  110,  110,  128,  128,  132,  132,  146,  146,  154,  154,  164,  164,  176,  176,  182,  182,  198,  198,  200,  200,
+      99,   99,  100,  100,  101,  101,  102,  102,  103,  103,  104,  104,  105,  105,  106,  106,  107,  107,  108,  108,  109,  109,   -1,   -1,  111,  111,  127,  127,  133,  133,  145,  145,  155,  155,  163,  163,  177,  177,  181,  181,  199,  199,   -1,
+      99,   99,  100,  100,  101,  101,  102,  102,  103,  103,  104,  104,  105,  105,  106,  106,  107,  107,  108,  108,  109,  109,   -1,   -1,  111,  111,  127,  127,  133,  133,  145,  145,  155,  155,  163,  163,  177,  177,  181,  181,  199,  199,   -1,
+      -1,   98,   98,   97,   97,   96,   96,   95,   95,   94,   94,   93,   93,   92,   92,   91,   91,   90,   90,   89,   89,   88,   88,   -1,   -1,  112,  112,  126,  126,  134,  134,  144,  144,  156,  156,  162,  162,  178,  178,  180,  180,   -1,   -1,
+      -1,   98,   98,   97,   97,   96,   96,   95,   95,   94,   94,   93,   93,   92,   92,   91,   91,   90,   90,   89,   89,   88,   88,   -1,   -1,  112,  112,  126,  126,  134,  134,  144,  144,  156,  156,  162,  162,  178,  178,  180,  180,   -1,   -1,
+      -1,   -1,   77,   77,   78,   78,   79,   79,   80,   80,   81,   81,   82,   82,   83,   83,   84,   84,   85,   85,   86,   86,   87,   87,   -1,   -1,  113,  113,  125,  125,  135,  135,  143,  143,  157,  157,  161,  161,  179,  179,   -1,   -1,   -1,
+      -1,   -1,   77,   77,   78,   78,   79,   79,   80,   80,   81,   81,   82,   82,   83,   83,   84,   84,   85,   85,   86,   86,   87,   87,   -1,   -1,  113,  113,  125,  125,  135,  135,  143,  143,  157,  157,  161,  161,  179,  179,   -1,   -1,   -1,
+      -1,   -1,   -1,   76,   76,   75,   75,   74,   74,   73,   73,   72,   72,   71,   71,   70,   70,   69,   69,   68,   68,   67,   67,   66,   66,   -1,   -1,  114,  114,  124,  124,  136,  136,  142,  142,  158,  158,  160,  160,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   76,   76,   75,   75,   74,   74,   73,   73,   72,   72,   71,   71,   70,   70,   69,   69,   68,   68,   67,   67,   66,   66,   -1,   -1,  114,  114,  124,  124,  136,  136,  142,  142,  158,  158,  160,  160,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   55,   55,   56,   56,   57,   57,   58,   58,   59,   59,   60,   60,   61,   61,   62,   62,   63,   63,   64,   64,   65,   65,   -1,   -1,  115,  115,  123,  123,  137,  137,  141,  141,  159,  159,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   55,   55,   56,   56,   57,   57,   58,   58,   59,   59,   60,   60,   61,   61,   62,   62,   63,   63,   64,   64,   65,   65,   -1,   -1,  115,  115,  123,  123,  137,  137,  141,  141,  159,  159,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   54,   54,   53,   53,   52,   52,   51,   51,   50,   50,   49,   49,   48,   48,   47,   47,   46,   46,   45,   45,   44,   44,   -1,   -1,  116,  116,  122,  122,  138,  138,  140,  140,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   54,   54,   53,   53,   52,   52,   51,   51,   50,   50,   49,   49,   48,   48,   47,   47,   46,   46,   45,   45,   44,   44,   -1,   -1,  116,  116,  122,  122,  138,  138,  140,  140,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   33,   33,   34,   34,   35,   35,   36,   36,   37,   37,   38,   38,   39,   39,   40,   40,   41,   41,   42,   42,   43,   43,   -1,   -1,  117,  117,  121,  121,  139,  139,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   33,   33,   34,   34,   35,   35,   36,   36,   37,   37,   38,   38,   39,   39,   40,   40,   41,   41,   42,   42,   43,   43,   -1,   -1,  117,  117,  121,  121,  139,  139,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,   32,   32,   31,   31,   30,   30,   29,   29,   28,   28,   27,   27,   26,   26,   25,   25,   24,   24,   23,   23,   22,   22,   -1,   -1,  118,  118,  120,  120,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,   32,   32,   31,   31,   30,   30,   29,   29,   28,   28,   27,   27,   26,   26,   25,   25,   24,   24,   23,   23,   22,   22,   -1,   -1,  118,  118,  120,  120,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   11,   11,   12,   12,   13,   13,   14,   14,   15,   15,   16,   16,   17,   17,   18,   18,   19,   19,   20,   20,   21,   21,   -1,   -1,  119,  119,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   11,   11,   12,   12,   13,   13,   14,   14,   15,   15,   16,   16,   17,   17,   18,   18,   19,   19,   20,   20,   21,   21,   -1,   -1,  119,  119,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   10,   10,    9,    9,    8,    8,    7,    7,    6,    6,    5,    5,    4,    4,    3,    3,    2,    2,    1,    1,    0,    0,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+      -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   10,   10,    9,    9,    8,    8,    7,    7,    6,    6,    5,    5,    4,    4,    3,    3,    2,    2,    1,    1,    0,    0,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1
+};
+
+// sets layout to the one described by layoutfile, or to the HERA display's when layoutfile is NULL, and
+// counts the pixels of every LED, returns 1 (after saying why) if layoutfile can't be read or isn't valid
+int loadLayout (const char *layoutfile)
+{
+    if (layoutfile == NULL)
+    {
+        layout.width = HERA_WIDTH;
+        layout.height = HERA_HEIGHT;
+        layout.ledCount = HERA_LED_COUNT;
+        memcpy(layout.index, heraIndex, sizeof(heraIndex));
+        return countPixels("the HERA layout");
+    }
+
+    FILE *file = fopen(layoutfile, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open %s.\n", layoutfile);
+        return 1;
+    }
+
+    // the file starts with the size of the scaled image and the number of LEDs
+    int line = 1;
+    long values[3];
+    static const long limits[3] = {SCALED_MAX_WIDTH, SCALED_MAX_HEIGHT, LED_MAX_COUNT};
+    for (int i = 0; i < 3; i++)
+    {
+        if (readNumber(file, &values[i], &line) != 0 || values[i] < 1 || values[i] > limits[i])
+        {
+            fprintf(stderr, "%s needs to start with <width (up to %i)> <height (up to %i)> <LED count (up to %i)>.\n",
+                    layoutfile, SCALED_MAX_WIDTH, SCALED_MAX_HEIGHT, LED_MAX_COUNT);
+            fclose(file);
+            return 1;
+        }
+    }
+    layout.width = values[0];
+    layout.height = values[1];
+    layout.ledCount = values[2];
+
+    // then the LED of every pixel, row by row, and nothing after them
+    long size = (long) layout.width * layout.height;
+    for (long i = 0; i < size; i++)
+    {
+        long value;
+        int status = readNumber(file, &value, &line);
+        if (status == 1)
+        {
+            fprintf(stderr, "%s ends after %li of its %li LED numbers.\n", layoutfile, i, size);
+            fclose(file);
+            return 1;
+        }
+        if (status != 0 || value < -1 || value >= layout.ledCount)
+        {
+            fprintf(stderr, "Line %i of %s needs LED numbers from 0 to %i (or -1 for none), %li of them in all.\n",
+                    line, layoutfile, layout.ledCount - 1, size);
+            fclose(file);
+            return 1;
+        }
+        layout.index[i] = value;
+    }
+    long extra;
+    if (readNumber(file, &extra, &line) != 1)
+    {
+        fprintf(stderr, "Line %i of %s is past the last of its %li LED numbers.\n", line, layoutfile, size);
+        fclose(file);
+        return 1;
+    }
+
+    fclose(file);
+    return countPixels(layoutfile);
+}
+
+// reads the next whole number from file, skipping white space and comments (from # to the end of the line)
+// and counting the lines passed, returns 1 at the end of the file or 2 if what comes next isn't a number
+int readNumber (FILE *file, long *value, int *line)
+{
+    int c;
+    while ((c = getc(file)) != EOF)
+    {
+        if (c == '#')
+        {
+            while (c != '\n' && c != EOF)
+            {
+                c = getc(file);
+            }
+        }
+        if (c == '\n')
+        {
+            (*line)++;
+        }
+        else if (c != EOF && !isspace(c))
+        {
+            break;
+        }
+    }
+    if (c == EOF)
+    {
+        return 1;
+    }
+
+    bool negative = c == '-';
+    if (negative)
+    {
+        c = getc(file);
+    }
+    if (!isdigit(c))
+    {
+        return 2;
+    }
+
+    long number = 0;
+    while (isdigit(c))
+    {
+        if (number <= NUMBER_MAX)
+        {
+            number = number * 10 + c - '0';
+        }
+        c = getc(file);
+    }
+
+    // a number runs up to white space, a comment or the end of the file, which are left for the next one
+    if (c != EOF && !isspace(c) && c != '#')
+    {
+        return 2;
+    }
+    ungetc(c, file);
+
+    *value = negative ? -number : number;
+    return 0;
+}
+
+// counts the pixels of the scaled image that make up each LED, returns 1 if any LED has none (as it would
+// never light up), naming the layout it came from
+int countPixels (const char *name)
+{
+    memset(layout.pixels, 0, layout.ledCount * sizeof(layout.pixels[0]));
+    for (long i = 0; i < (long) layout.width * layout.height; i++)
+    {
+        if (layout.index[i] != -1)
+        {
+            layout.pixels[layout.index[i]]++;
+        }
+    }
+
+    for (int n = 0; n < layout.ledCount; n++)
+    {
+        if (layout.pixels[n] == 0)
+        {
+            fprintf(stderr, "LED %i of %s isn't on any pixel.\n", n, name);
+            return 1;
+        }
+    }
+    return 0;
+}
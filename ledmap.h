@@ -0,0 +1,31 @@
+#ifndef LEDMAP_H
+#define LEDMAP_H
+
+#include <stdint.h>
+
+// biggest scaled image a layout can map LEDs onto
+#define SCALED_MAX_WIDTH 128
+#define SCALED_MAX_HEIGHT 128
+
+// most LEDs a layout can have
+#define LED_MAX_COUNT 4096
+
+// how a display's LEDs sit on the scaled image: the image is width x height px, index holds the LED number
+// (0 to ledCount - 1) of every pixel of it row by row (y = 0 is the top row, -1 where there is no LED) with
+// no gaps between rows, and pixels counts how many pixels each LED covers
+typedef struct
+{
+    int width;
+    int height;
+    int ledCount;
+    int16_t index[SCALED_MAX_WIDTH * SCALED_MAX_HEIGHT];
+    int pixels[LED_MAX_COUNT];
+}
+LEDLAYOUT;
+
+// the layout of the display being converted for, set once by loadLayout before anything else runs
+extern LEDLAYOUT layout;
+
+int loadLayout (const char *layoutfile);
+
+#endif
@@ -1,28 +1,122 @@
 // *******************************************************************************************************
-// Takes a 24-bit BMP file and scales it to a 43x42 px temp file (temp.bmp) and then outputs a named csv
-// file (2nd argument) with RGB values for 320 premapped LED lights for a HERA display.
+// Takes a csv file written by ledcsv, checks every frame in it and draws the first one (or all of them, tiled
+// into a contact sheet) as the HERA display would show it (ledmap.bmp) on the 43x42 px layout, or as the
+// display of a layout file given with -m would, optionally with each pixel grown to a block.
 // *******************************************************************************************************
 
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "bmp.h"
+#include "ledmap.h"
 
-int getLEDIndex (int x, int y);
+// biggest block of pixels drawn for each LED
+#define MAX_SCALE 64
+
+// whole contents of a file, either mapped or (for pipes, stdin) read into memory
+typedef struct
+{
+    char *data;
+    size_t size;
+    bool mapped;
+}
+CONTENTS;
+
+// LED values parsed from a csv file, layout.ledCount per frame one frame after the other
+typedef struct
+{
+    RGBTRIPLE *frames;
+    int count;
+}
+CSVFRAMES;
+
+// one pixel of the scaled image layout that shows an LED, and where its block starts in a tile
+typedef struct
+{
+    long offset;
+    int led;
+}
+LEDCELL;
+
+int loadFile (FILE *file, CONTENTS *contents);
+void unloadFile (CONTENTS *contents);
+int parseCSV (const char *text, size_t size, char *name, CSVFRAMES *frames);
+const char *parseNumber (const char *p, const char *end, int *value);
+
+int layoutCells (LEDCELL *cells, long stride, int scale);
+void drawFrame (const RGBTRIPLE *led, const LEDCELL *cells, int cellCount, BYTE *tile, long stride, int scale);
 
 int main(int argc, char *argv[])
 {
+    char *usage = "Usage: ./testcsv [-c columns] [-m layout] [-x scale] <csv file (input)>\n";
+
+    // every LED is drawn as a scale x scale block of pixels
+    long scale = 1;
+
+    // a contact sheet draws every frame in rows of columns frames, 0 picks a square-ish grid
+    bool sheet = false;
+    long columns = 0;
+
+    // file describing the display's layout, the HERA display's is built in
+    char *layoutfile = NULL;
+
+    int opt;
+    char *end;
+    while ((opt = getopt(argc, argv, "c:m:x:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c':
+                sheet = true;
+                columns = strtol(optarg, &end, 10);
+                if (*end != '\0' || columns < 0 || columns > INT_MAX)
+                {
+                    fprintf(stderr, "%s", usage);
+                    return 1;
+                }
+                break;
+
+            case 'm':
+                layoutfile = optarg;
+                break;
+
+            case 'x':
+                scale = strtol(optarg, &end, 10);
+                if (*end != '\0' || scale < 1 || scale > MAX_SCALE)
+                {
+                    fprintf(stderr, "%s", usage);
+                    return 1;
+                }
+                break;
+
+            default:
+                fprintf(stderr, "%s", usage);
+                return 1;
+        }
+    }
+
     // ensure proper usage
-    if (argc != 2)
+    if (argc - optind != 1)
+    {
+        fprintf(stderr, "%s", usage);
+        return 1;
+    }
+
+    // the LEDs every frame has and where they go
+    if (loadLayout(layoutfile) != 0)
     {
-        fprintf(stderr, "Usage: ./testcsv <csv file (input)>\n");
         return 1;
     }
 
     // remember filenames
-    char *infile = argv[1];
-    char *tempfile = "temp.bmp";
+    char *infile = argv[optind];
     char *outfile = "ledmap.bmp";
 
     // open input file
@@ -33,1467 +127,386 @@ int main(int argc, char *argv[])
         return 2;
     }
 
-    // open temp file to mirror headers
-    FILE *tempptr = fopen(tempfile, "r");
-    if (tempptr == NULL)
+    // take in the whole csv file at once
+    CONTENTS contents;
+    if (loadFile(inptr, &contents) != 0)
     {
         fclose(inptr);
-        fprintf(stderr, "Could not open %s.\n", tempfile);
-        return 3;
+        fprintf(stderr, "Could not read %s.\n", infile);
+        return 2;
+    }
+
+    // read csv file and store RGB values of every frame, checking them as we go
+    CSVFRAMES frames;
+    int status = parseCSV(contents.data, contents.size, infile, &frames);
+
+    unloadFile(&contents);
+    fclose(inptr);
+
+    if (status != 0)
+    {
+        return 5;
+    }
+
+    // the preview shows the first frame, a contact sheet shows them all in rows of columns frames
+    int count = 1;
+    if (sheet)
+    {
+        count = frames.count;
+        if (columns == 0)
+        {
+            // as close to square as the frames allow
+            columns = 1;
+            while (columns * columns < count)
+            {
+                columns++;
+            }
+        }
+        else if (columns > count)
+        {
+            columns = count;
+        }
+    }
+    else
+    {
+        columns = 1;
+    }
+    long rows = (count + columns - 1) / columns;
+
+    // every frame is a tile of the scaled image layout, with every pixel grown to scale x scale
+    long tileWidth = layout.width * scale;
+    long tileHeight = layout.height * scale;
+
+    // determine padding for scanlines
+    int padding = (4 - (tileWidth * columns * sizeof(RGBTRIPLE)) % 4) % 4;
+    long stride = tileWidth * columns * sizeof(RGBTRIPLE) + padding;
+
+    // a bitmap can't describe more than 4 GB of pixels
+    if ((double) stride * tileHeight * rows > UINT32_MAX - sizeof(BITMAPINFOHEADER) - sizeof(BITMAPFILEHEADER))
+    {
+        free(frames.frames);
+        fprintf(stderr, "A %lix%li preview is too big for a bitmap.\n", tileWidth * columns, tileHeight * rows);
+        return 6;
+    }
+
+    BITMAPINFOHEADER bi =
+    {
+        .biSize = sizeof(BITMAPINFOHEADER),
+        .biWidth = tileWidth * columns,
+        .biHeight = tileHeight * rows,
+        .biPlanes = 1,
+        .biBitCount = 24,
+        .biCompression = 0,
+        .biSizeImage = stride * tileHeight * rows,
+        .biXPelsPerMeter = 2835,
+        .biYPelsPerMeter = 2835
+    };
+
+    BITMAPFILEHEADER bf =
+    {
+        .bfType = 0x4d42,
+        .bfSize = bi.biSizeImage + sizeof(BITMAPINFOHEADER) + sizeof(BITMAPFILEHEADER),
+        .bfOffBits = sizeof(BITMAPINFOHEADER) + sizeof(BITMAPFILEHEADER)
+    };
+
+    // draw the frames into one zeroed image, so padding and unlit pixels are already black
+    BYTE *image = calloc(bi.biSizeImage, 1);
+    if (image == NULL)
+    {
+        free(frames.frames);
+        fprintf(stderr, "Not enough memory for a %ix%i preview.\n", bi.biWidth, bi.biHeight);
+        return 6;
+    }
+
+    // where each LED's pixels go in a tile is the same for every frame
+    LEDCELL cells[SCALED_MAX_HEIGHT * SCALED_MAX_WIDTH];
+    int cellCount = layoutCells(cells, stride, scale);
+
+    for (int f = 0; f < count; f++)
+    {
+        // scanlines run bottom up, so the first row of frames goes at the end of the image
+        long row = rows - 1 - f / columns;
+        long column = f % columns;
+        BYTE *tile = image + row * tileHeight * stride + column * tileWidth * sizeof(RGBTRIPLE);
+
+        drawFrame(frames.frames + (long) f * layout.ledCount, cells, cellCount, tile, stride, scale);
     }
+    free(frames.frames);
 
     // open output file
     FILE *outptr = fopen(outfile, "w");
     if (outptr == NULL)
     {
-        fclose(inptr);
-        fclose(tempptr);
+        free(image);
         fprintf(stderr, "Could not create %s.\n", outfile);
         return 4;
     }
 
-    // read temp files's BITMAPFILEHEADER
-    BITMAPFILEHEADER bf;
-    fread(&bf, sizeof(BITMAPFILEHEADER), 1, tempptr);
-
-    // read infile's BITMAPINFOHEADER
-    BITMAPINFOHEADER bi;
-    fread(&bi, sizeof(BITMAPINFOHEADER), 1, tempptr);
-
-    fclose(tempptr);
-
-    // determine padding for scanlines
-    int padding = (4 - (bi.biWidth * sizeof(RGBTRIPLE)) % 4) % 4;
-
-    // write outfile's headers
+    // write outfile's headers and image
     fwrite(&bf, sizeof(BITMAPFILEHEADER), 1, outptr);
     fwrite(&bi, sizeof(BITMAPINFOHEADER), 1, outptr);
+    fwrite(image, bi.biSizeImage, 1, outptr);
 
-    int xIndex = 0;
-    char buffer[24];
-    int fieldCount;
-    int rowCount = 0;
+    free(image);
 
-    // set up structure for numbered LEDs
-    RGBTRIPLE *led = malloc(320 * sizeof(RGBTRIPLE));
-    for (int n = 0; n < 320; n++)
+    if (fclose(outptr) != 0)
     {
-        led[n].rgbtRed = 0;
-        led[n].rgbtGreen = 0;
-        led[n].rgbtBlue = 0;
+        fprintf(stderr, "Could not write %s.\n", outfile);
+        return 4;
     }
-    int ledNumber;
 
-    // read csv file and store RGB values in LED structure
-    while (fgets(buffer, 24, inptr))
-    {
-        fieldCount = 0;
-        char *fields = strtok(buffer, ", ");
+    // success
+    return 0;
+}
+
+// maps file into memory when it's a regular file, otherwise reads all of it into a buffer,
+// returns 1 if it can't be read
+int loadFile (FILE *file, CONTENTS *contents)
+{
+    contents->data = NULL;
+    contents->size = 0;
+    contents->mapped = false;
 
-        while (fields)
+    struct stat st;
+    if (fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode))
+    {
+        // an empty file can't be mapped, but there's nothing to read either
+        if (st.st_size == 0)
         {
-            if (fieldCount == 1)
-            {
-                led[rowCount].rgbtRed = atoi(fields);
-            }
-            else if (fieldCount == 2)
-            {
-                led[rowCount].rgbtGreen = atoi(fields);
-            }
-            else if (fieldCount == 3)
-            {
-                led[rowCount].rgbtBlue = atoi(fields);
-            }
+            return 0;
+        }
 
-            fields = strtok(NULL, ", ");
-            fieldCount++;
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (map != MAP_FAILED)
+        {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            contents->data = map;
+            contents->size = st.st_size;
+            contents->mapped = true;
+            return 0;
         }
-        rowCount++;
     }
 
-    fclose(inptr);
-
-    // iterate over scaled file's scanlines
-    for (int i = 0; i < bi.biHeight; i++)
+    // read in big blocks, doubling the buffer as it fills
+    size_t capacity = 0;
+    while (true)
     {
-        // iterate over pixels in scanline
-        for (int j = 0; j < bi.biWidth; j++)
+        if (contents->size == capacity)
         {
-            // only write info on valid LEDs from the scaled image
-            ledNumber = getLEDIndex(j, i);
-            if (ledNumber != -1)
+            capacity = capacity ? 2 * capacity : 1 << 16;
+            char *grown = realloc(contents->data, capacity);
+            if (grown == NULL)
             {
-                // write RGB triple to outfile
-                fwrite(&led[ledNumber].rgbtBlue, sizeof(BYTE), 1, outptr);
-                fwrite(&led[ledNumber].rgbtGreen, sizeof(BYTE), 1, outptr);
-                fwrite(&led[ledNumber].rgbtRed, sizeof(BYTE), 1, outptr);
-            }
-            else
-            {
-                fputc(0x00, outptr);
-                fputc(0x00, outptr);
-                fputc(0x00, outptr);
+                free(contents->data);
+                return 1;
             }
+            contents->data = grown;
         }
 
-        // add output padding
-        for (int j = 0; j < padding; j++)
+        size_t got = fread(contents->data + contents->size, 1, capacity - contents->size, file);
+        contents->size += got;
+        if (got == 0)
         {
-            fputc(0x00, outptr);
+            break;
         }
     }
 
-    fclose(outptr);
-
-    // success
+    if (ferror(file))
+    {
+        free(contents->data);
+        return 1;
+    }
     return 0;
 }
 
-// maps specific x,y coordinates of the pixels from scaled image to predetermined LED numbers for csv
-int getLEDIndex (int x, int y)
+// releases whatever loadFile set up
+void unloadFile (CONTENTS *contents)
 {
-    if (y == 0 || y == 1)
+    if (contents->mapped)
     {
-        if (x == 9 || x == 10)
-        {
-            return 220;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 219;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 218;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 217;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 216;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 215;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 214;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 213;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 212;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 211;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 210;
-        }
+        munmap(contents->data, contents->size);
     }
-    else if (y == 2 || y == 3)
+    else
     {
-        if (x == 8 || x == 9)
-        {
-            return 221;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 222;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 223;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 224;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 225;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 226;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 227;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 228;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 229;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 230;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 231;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 209;
-        }
+        free(contents->data);
     }
-    else if (y == 4 || y == 5)
+    contents->data = NULL;
+}
+
+// parses "n, r, g, b" lines in one pass over text, layout.ledCount lines per frame with n running from 0 to
+// layout.ledCount - 1 in each frame and colours from 0 to 255, reporting the first problem against name,
+// returns 1 if the csv is invalid (frames then holds nothing)
+int parseCSV (const char *text, size_t size, char *name, CSVFRAMES *frames)
+{
+    const char *p = text;
+    const char *end = text + size;
+
+    frames->frames = NULL;
+    frames->count = 0;
+    int capacity = 0;
+
+    int line = 0;
+    long leds = 0;
+    while (p < end)
     {
-        if (x == 7 || x == 8)
-        {
-            return 242;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 241;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 240;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 239;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 238;
-        }
-        else if (x == 17 || x == 18)
+        line++;
+
+        // skip blank lines
+        const char *start = p;
+        while (start < end && (*start == ' ' || *start == '\t' || *start == '\r'))
         {
-            return 237;
+            start++;
         }
-        else if (x == 19 || x == 20)
+        if (start == end || *start == '\n')
         {
-            return 236;
+            p = start + 1;
+            continue;
         }
-        else if (x == 21 || x == 22)
+
+        // n, r, g and b, separated by commas
+        int values[4];
+        for (int f = 0; f < 4 && p != NULL; f++)
         {
-            return 235;
+            p = parseNumber(p, end, &values[f]);
+            if (p != NULL && f < 3)
+            {
+                p = p < end && *p == ',' ? p + 1 : NULL;
+            }
         }
-        else if (x == 23 || x == 24)
+
+        // then only the end of the line
+        while (p != NULL && p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
         {
-            return 234;
+            p++;
         }
-        else if (x == 25 || x == 26)
+        if (p == NULL || (p < end && *p != '\n'))
         {
-            return 233;
+            fprintf(stderr, "Line %i of %s needs to be <LED number>, <red>, <green>, <blue>.\n", line, name);
+            free(frames->frames);
+            return 1;
         }
-        else if (x == 27 || x == 28)
+        p++;
+
+        int ledNumber = leds % layout.ledCount;
+        if (values[0] != ledNumber)
         {
-            return 232;
+            fprintf(stderr, "Line %i of %s is for LED %i, expected LED %i.\n", line, name, values[0], ledNumber);
+            free(frames->frames);
+            return 1;
         }
-        else if (x == 31 || x == 32)
+        if (values[1] > 255 || values[2] > 255 || values[3] > 255)
         {
-            return 190;
+            fprintf(stderr, "Line %i of %s has a colour value over 255.\n", line, name);
+            free(frames->frames);
+            return 1;
         }
-        else if (x == 33 || x == 34)
+
+        // start a new frame, doubling the room for them as needed
+        if (ledNumber == 0)
         {
-            return 208;
+            if (frames->count == capacity)
+            {
+                capacity = capacity ? 2 * capacity : 16;
+                RGBTRIPLE *grown = realloc(frames->frames, (size_t) capacity * layout.ledCount * sizeof(RGBTRIPLE));
+                if (grown == NULL)
+                {
+                    fprintf(stderr, "Not enough memory to read %s.\n", name);
+                    free(frames->frames);
+                    return 1;
+                }
+                frames->frames = grown;
+            }
+            frames->count++;
         }
+
+        RGBTRIPLE *led = &frames->frames[(long) (frames->count - 1) * layout.ledCount + ledNumber];
+        led->rgbtRed = values[1];
+        led->rgbtGreen = values[2];
+        led->rgbtBlue = values[3];
+        leds++;
     }
-    else if (y == 6 || y == 7)
+
+    if (leds == 0 || leds % layout.ledCount != 0)
     {
-        if (x == 6 || x == 7)
-        {
-            return 243;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 244;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 245;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 246;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 247;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 248;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 249;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 250;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 251;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 252;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 253;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 189;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 191;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 207;
-        }
+        fprintf(stderr, "%s needs %i lines for every frame, it has %li.\n", name, layout.ledCount, leds);
+        free(frames->frames);
+        return 1;
     }
-    else if (y == 8 || y == 9)
+    return 0;
+}
+
+// reads an unsigned decimal number surrounded by optional spaces or tabs starting at p, returns where it
+// ends or NULL if there isn't one, values too big for a colour or LED number are capped rather than overflowing
+const char *parseNumber (const char *p, const char *end, int *value)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
     {
-        if (x == 5 || x == 6)
-        {
-            return 264;
-        }
-        else if (x == 7 || x == 8)
-        {
-            return 263;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 262;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 261;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 260;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 259;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 258;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 257;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 256;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 255;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 254;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 170;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 188;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 192;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 206;
-        }
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9')
+    {
+        return NULL;
     }
-    else if (y == 10 || y == 11)
+
+    int number = 0;
+    while (p < end && *p >= '0' && *p <= '9')
     {
-        if (x == 4 || x == 5)
+        if (number < 100000)
         {
-            return 265;
+            number = number * 10 + (*p - '0');
         }
-        else if (x == 6 || x == 7)
+        p++;
+    }
+    *value = number;
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    return p;
+}
+
+// finds the pixels of the scaled image layout that show an LED, and the offset of each one's scale x scale block
+// from the start of a tile in an image with scanlines stride bytes apart, returns how many there are
+int layoutCells (LEDCELL *cells, long stride, int scale)
+{
+    int count = 0;
+
+    // iterate over the layout's rows, each becoming scale scanlines
+    for (int i = 0; i < layout.height; i++)
+    {
+        const int16_t *index = layout.index + i * layout.width;
+
+        // iterate over pixels in the row, only keeping valid LEDs
+        for (int j = 0; j < layout.width; j++)
         {
-            return 266;
+            if (index[j] != -1)
+            {
+                cells[count].offset = (long) i * scale * stride + (long) j * scale * sizeof(RGBTRIPLE);
+                cells[count].led = index[j];
+                count++;
+            }
         }
-        else if (x == 8 || x == 9)
+    }
+
+    return count;
+}
+
+// draws one frame's LEDs into the tile starting at tile, leaving pixels without an LED alone
+void drawFrame (const RGBTRIPLE *led, const LEDCELL *cells, int cellCount, BYTE *tile, long stride, int scale)
+{
+    for (int c = 0; c < cellCount; c++)
+    {
+        BYTE *block = tile + cells[c].offset;
+        for (int k = 0; k < scale; k++)
         {
-            return 267;
+            memcpy(block + k * sizeof(RGBTRIPLE), &led[cells[c].led], sizeof(RGBTRIPLE));
         }
-        else if (x == 10 || x == 11)
+
+        // the rest of the block's scanlines are copies of the first
+        for (int k = 1; k < scale; k++)
         {
-            return 268;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 269;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 270;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 271;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 272;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 273;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 274;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 275;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 169;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 171;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 187;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 193;
-        }
-        else if (x == 36 || x == 37)
-        {
-            return 205;
-        }
-    }
-    else if (y == 12 || y == 13)
-    {
-        if (x == 3 || x == 4)
-        {
-            return 286;
-        }
-        else if (x == 5 || x == 6)
-        {
-            return 285;
-        }
-        else if (x == 7 || x == 8)
-        {
-            return 284;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 283;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 282;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 281;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 280;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 279;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 278;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 277;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 276;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 150;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 168;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 172;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 186;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 194;
-        }
-        else if (x == 37 || x == 38)
-        {
-            return 204;
-        }
-    }
-    else if (y == 14 || y == 15)
-    {
-        if (x == 2 || x == 3)
-        {
-            return 287;
-        }
-        else if (x == 4 || x == 5)
-        {
-            return 288;
-        }
-        else if (x == 6 || x == 7)
-        {
-            return 289;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 290;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 291;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 292;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 293;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 294;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 295;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 296;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 297;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 149;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 151;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 167;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 173;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 185;
-        }
-        else if (x == 36 || x == 37)
-        {
-            return 195;
-        }
-        else if (x == 38 || x == 39)
-        {
-            return 203;
-        }
-    }
-    else if (y == 16 || y == 17)
-    {
-        if (x == 1 || x == 2)
-        {
-            return 308;
-        }
-        else if (x == 3 || x == 4)
-        {
-            return 307;
-        }
-        else if (x == 5 || x == 6)
-        {
-            return 306;
-        }
-        else if (x == 7 || x == 8)
-        {
-            return 305;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 304;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 303;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 302;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 301;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 300;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 299;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 298;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 130;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 148;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 152;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 166;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 174;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 184;
-        }
-        else if (x == 37 || x == 38)
-        {
-            return 196;
-        }
-        else if (x == 39 || x == 40)
-        {
-            return 202;
-        }
-    }
-    else if (y == 18 || y == 19)
-    {
-        if (x == 0 || x == 1)
-        {
-            return 309;
-        }
-        else if (x == 2 || x == 3)
-        {
-            return 310;
-        }
-        else if (x == 4 || x == 5)
-        {
-            return 311;
-        }
-        else if (x == 6 || x == 7)
-        {
-            return 312;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 313;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 314;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 315;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 316;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 317;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 318;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 319;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 129;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 131;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 147;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 153;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 165;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 175;
-        }
-        else if (x == 36 || x == 37)
-        {
-            return 183;
-        }
-        else if (x == 38 || x == 39)
-        {
-            return 197;
-        }
-        else if (x == 40 || x == 41)
-        {
-            return 201;
-        }
-    }
-    else if (y == 20 || y == 21)
-    {
-        if (x == 23 || x == 24)
-        {
-            return 110;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 128;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 132;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 146;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 154;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 164;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 176;
-        }
-        else if (x == 37 || x == 38)
-        {
-            return 182;
-        }
-        else if (x == 39 || x == 40)
-        {
-            return 198;
-        }
-        else if (x == 41 || x == 42)
-        {
-            return 200;
-        }
-    }
-    else if (y == 22 || y == 23)
-    {
-        if (x == 0 || x == 1)
-        {
-            return 99;
-        }
-        else if (x == 2 || x == 3)
-        {
-            return 100;
-        }
-        else if (x == 4 || x == 5)
-        {
-            return 101;
-        }
-        else if (x == 6 || x == 7)
-        {
-            return 102;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 103;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 104;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 105;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 106;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 107;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 108;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 109;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 111;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 127;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 133;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 145;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 155;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 163;
-        }
-        else if (x == 36 || x == 37)
-        {
-            return 177;
-        }
-        else if (x == 38 || x == 39)
-        {
-            return 181;
-        }
-        else if (x == 40 || x == 41)
-        {
-            return 199;
-        }
-    }
-    else if (y == 24 || y == 25)
-    {
-        if (x == 1 || x == 2)
-        {
-            return 98;
-        }
-        else if (x == 3 || x == 4)
-        {
-            return 97;
-        }
-        else if (x == 5 || x == 6)
-        {
-            return 96;
-        }
-        else if (x == 7 || x == 8)
-        {
-            return 95;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 94;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 93;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 92;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 91;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 90;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 89;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 88;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 112;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 126;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 134;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 144;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 156;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 162;
-        }
-        else if (x == 37 || x == 38)
-        {
-            return 178;
-        }
-        else if (x == 39 || x == 40)
-        {
-            return 180;
-        }
-    }
-    else if (y == 26 || y == 27)
-    {
-        if (x == 2 || x == 3)
-        {
-            return 77;
-        }
-        else if (x == 4 || x == 5)
-        {
-            return 78;
-        }
-        else if (x == 6 || x == 7)
-        {
-            return 79;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 80;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 81;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 82;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 83;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 84;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 85;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 86;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 87;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 113;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 125;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 135;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 143;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 157;
-        }
-        else if (x == 36 || x == 37)
-        {
-            return 161;
-        }
-        else if (x == 38 || x == 39)
-        {
-            return 179;
-        }
-    }
-    else if (y == 28 || y == 29)
-    {
-        if (x == 3 || x == 4)
-        {
-            return 76;
-        }
-        else if (x == 5 || x == 6)
-        {
-            return 75;
-        }
-        else if (x == 7 || x == 8)
-        {
-            return 74;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 73;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 72;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 71;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 70;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 69;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 68;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 67;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 66;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 114;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 124;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 136;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 142;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 158;
-        }
-        else if (x == 37 || x == 38)
-        {
-            return 160;
-        }
-    }
-    else if (y == 30 || y == 31)
-    {
-        if (x == 4 || x == 5)
-        {
-            return 55;
-        }
-        else if (x == 6 || x == 7)
-        {
-            return 56;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 57;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 58;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 59;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 60;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 61;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 62;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 63;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 64;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 65;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 115;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 123;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 137;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 141;
-        }
-        else if (x == 36 || x == 37)
-        {
-            return 159;
-        }
-    }
-    else if (y == 32 || y == 33)
-    {
-        if (x == 5 || x == 6)
-        {
-            return 54;
-        }
-        else if (x == 7 || x == 8)
-        {
-            return 53;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 52;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 51;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 50;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 49;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 48;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 47;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 46;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 45;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 44;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 116;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 122;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 138;
-        }
-        else if (x == 35 || x == 36)
-        {
-            return 140;
-        }
-    }
-    else if (y == 34 || y == 35)
-    {
-        if (x == 6 || x == 7)
-        {
-            return 33;
-        }
-        else if (x == 8 || x == 9)
-        {
-            return 34;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 35;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 36;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 37;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 38;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 39;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 40;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 41;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 42;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 43;
-        }
-        else if (x == 30 || x == 31)
-        {
-            return 117;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 121;
-        }
-        else if (x == 34 || x == 35)
-        {
-            return 139;
-        }
-    }
-    else if (y == 36 || y == 37)
-    {
-        if (x == 7 || x == 8)
-        {
-            return 32;
-        }
-        else if (x == 9 || x == 10)
-        {
-            return 31;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 30;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 29;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 28;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 27;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 26;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 25;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 24;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 23;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 22;
-        }
-        else if (x == 31 || x == 32)
-        {
-            return 118;
-        }
-        else if (x == 33 || x == 34)
-        {
-            return 120;
-        }
-    }
-    else if (y == 38 || y == 39)
-    {
-        if (x == 8 || x == 9)
-        {
-            return 11;
-        }
-        else if (x == 10 || x == 11)
-        {
-            return 12;
-        }
-        else if (x == 12 || x == 13)
-        {
-            return 13;
-        }
-        else if (x == 14 || x == 15)
-        {
-            return 14;
-        }
-        else if (x == 16 || x == 17)
-        {
-            return 15;
-        }
-        else if (x == 18 || x == 19)
-        {
-            return 16;
-        }
-        else if (x == 20 || x == 21)
-        {
-            return 17;
-        }
-        else if (x == 22 || x == 23)
-        {
-            return 18;
-        }
-        else if (x == 24 || x == 25)
-        {
-            return 19;
-        }
-        else if (x == 26 || x == 27)
-        {
-            return 20;
-        }
-        else if (x == 28 || x == 29)
-        {
-            return 21;
-        }
-        else if (x == 32 || x == 33)
-        {
-            return 119;
-        }
-    }
-    else if (y == 40 || y == 41)
-    {
-        if (x == 9 || x == 10)
-        {
-            return 10;
-        }
-        else if (x == 11 || x == 12)
-        {
-            return 9;
-        }
-        else if (x == 13 || x == 14)
-        {
-            return 8;
-        }
-        else if (x == 15 || x == 16)
-        {
-            return 7;
-        }
-        else if (x == 17 || x == 18)
-        {
-            return 6;
-        }
-        else if (x == 19 || x == 20)
-        {
-            return 5;
-        }
-        else if (x == 21 || x == 22)
-        {
-            return 4;
-        }
-        else if (x == 23 || x == 24)
-        {
-            return 3;
-        }
-        else if (x == 25 || x == 26)
-        {
-            return 2;
-        }
-        else if (x == 27 || x == 28)
-        {
-            return 1;
-        }
-        else if (x == 29 || x == 30)
-        {
-            return 0;
+            memcpy(block + k * stride, block, scale * sizeof(RGBTRIPLE));
         }
     }
-    return -1;
-}
\ No newline at end of file
+}